@@ -0,0 +1,198 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+#include "Profiler.h"
+
+// Destination of combine_files. Byte ranges of other files are appended without looking at
+// their contents: on Linux by the kernel (copy_file_range, then sendfile), elsewhere, or when
+// the kernel refuses, through a 1 MiB buffer.
+class concatenated_file {
+public:
+	static constexpr size_t BLOCK = size_t{ 1 } << 20;
+
+	explicit concatenated_file(const std::string& filename) : filename(filename) {
+#ifdef __linux__
+		fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) fail("Couldn't open destination file " + filename);
+#else
+		file.open(filename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) fail("Couldn't open destination file " + filename);
+#endif
+	}
+
+	~concatenated_file() {
+#ifdef __linux__
+		if (fd >= 0) ::close(fd);
+#endif
+	}
+
+	concatenated_file(const concatenated_file&) = delete;
+	concatenated_file& operator=(const concatenated_file&) = delete;
+
+	void write(const char* data, size_t size) {
+#ifdef __linux__
+		while (size > 0) {
+			ssize_t written = ::write(fd, data, size);
+			if (written < 0) {
+				if (errno == EINTR) continue;
+				fail("Write to " + filename + " failed");
+			}
+			data += written;
+			size -= static_cast<size_t>(written);
+		}
+#else
+		if (!file.write(data, static_cast<std::streamsize>(size))) fail("Write to " + filename + " failed");
+#endif
+	}
+
+	// Appends `length` bytes of `source` starting at byte `offset`.
+	void append(const std::string& source, std::uint64_t offset, std::uint64_t length) {
+#ifdef __linux__
+		int in = ::open(source.c_str(), O_RDONLY);
+		if (in < 0) fail("Couldn't open source file " + source);
+		off_t position = static_cast<off_t>(offset);
+		std::uint64_t remaining = length;
+		bool kernel_copy = true, kernel_send = true;
+		while (remaining > 0) {
+			ssize_t copied = -1;
+			if (kernel_copy) {
+				copied = ::copy_file_range(in, &position, fd, nullptr, remaining, 0);
+				if (copied < 0 && errno != EINTR) kernel_copy = false;
+			}
+			else if (kernel_send) {
+				copied = ::sendfile(fd, in, &position, remaining);
+				if (copied < 0 && errno != EINTR) kernel_send = false;
+			}
+			else {
+				copied = buffered_copy(in, position, remaining);
+			}
+			if (copied == 0) {
+				::close(in);
+				fail(source + " ended before the expected " + std::to_string(length) + " bytes");
+			}
+			if (copied > 0) remaining -= static_cast<std::uint64_t>(copied);
+		}
+		::close(in);
+#else
+		std::ifstream in{ source, std::ios::binary };
+		if (!in.is_open()) fail("Couldn't open source file " + source);
+		in.seekg(static_cast<std::streamoff>(offset));
+		std::vector<char> buffer(BLOCK);
+		std::uint64_t remaining = length;
+		while (remaining > 0) {
+			size_t chunk = static_cast<size_t>(std::min<std::uint64_t>(remaining, BLOCK));
+			if (!in.read(buffer.data(), static_cast<std::streamsize>(chunk))) {
+				fail(source + " ended before the expected " + std::to_string(length) + " bytes");
+			}
+			write(buffer.data(), chunk);
+			remaining -= chunk;
+		}
+#endif
+	}
+
+	void close() {
+#ifdef __linux__
+		if (fd >= 0 && ::close(fd) != 0) {
+			fd = -1;
+			fail("Closing " + filename + " failed");
+		}
+		fd = -1;
+#else
+		file.close();
+		if (file.fail()) fail("Closing " + filename + " failed");
+#endif
+	}
+
+private:
+	std::string filename;
+#ifdef __linux__
+	int fd = -1;
+
+	// One block through user space; returns bytes copied (0 at end of file, -1 on EINTR).
+	ssize_t buffered_copy(int in, off_t& position, std::uint64_t remaining) {
+		std::vector<char> buffer(static_cast<size_t>(std::min<std::uint64_t>(remaining, BLOCK)));
+		ssize_t got = ::pread(in, buffer.data(), buffer.size(), position);
+		if (got < 0) {
+			if (errno == EINTR) return -1;
+			fail("Read failed while copying into " + filename);
+		}
+		write(buffer.data(), static_cast<size_t>(got));
+		position += got;
+		return got;
+	}
+
+	[[noreturn]] void fail(const std::string& what) const {
+		throw std::runtime_error(what + " (" + std::strerror(errno) + ")");
+	}
+#else
+	std::ofstream file;
+
+	[[noreturn]] void fail(const std::string& what) const {
+		throw std::runtime_error(what);
+	}
+#endif
+};
+
+// Concatenates CSV files that share a header: the header is written once, every file's body
+// is copied as raw bytes, and a newline is added after a body that lacks one. Headers must
+// match (ignoring a trailing '\r'). The result is written to "<destination>.tmp" and renamed
+// over `destination` only once complete.
+void combine_files(const std::vector<std::string>& sources, const std::string& destination) {
+	FE_PROFILE_SCOPE("combine");
+	if (sources.empty()) {
+		throw std::runtime_error("Nothing to combine into " + destination);
+	}
+	const std::string temporary = destination + ".tmp";
+	try {
+		concatenated_file out{ temporary };
+		std::string first_header;
+		for (size_t i = 0; i < sources.size(); ++i) {
+			std::ifstream in{ sources[i], std::ios::binary };
+			if (!in.is_open()) {
+				throw std::runtime_error("Couldn't open source file " + sources[i]);
+			}
+			const std::uint64_t size = std::filesystem::file_size(sources[i]);
+			std::string header;
+			std::getline(in, header);
+			const std::uint64_t body_offset = in.eof() ? size : static_cast<std::uint64_t>(in.tellg());
+			if (!header.empty() && header.back() == '\r') header.pop_back();
+
+			if (i == 0) {
+				first_header = header;
+				out.write(header.data(), header.size());
+				out.write("\n", 1);
+			}
+			else if (header != first_header) {
+				throw std::runtime_error("Header of " + sources[i] + " does not match " + sources[0]);
+			}
+
+			if (size > body_offset) {
+				out.append(sources[i], body_offset, size - body_offset);
+				char last = '\n';
+				in.clear();
+				in.seekg(static_cast<std::streamoff>(size - 1));
+				in.get(last);
+				if (last != '\n') out.write("\n", 1);
+			}
+		}
+		out.close();
+		std::filesystem::rename(temporary, destination);
+	}
+	catch (...) {
+		std::error_code ignored;
+		std::filesystem::remove(temporary, ignored);
+		throw;
+	}
+}
@@ -0,0 +1,205 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FE_CORRELATION_SSE2
+#endif
+#include "DataFrame.h"
+#include "Parallel.h"
+
+// Mean-centered covariance and Pearson correlation over the numeric feature columns, plus
+// every feature's correlation with the target ranked by magnitude. Rows with a null in any
+// selected column are left out (listwise deletion).
+struct correlation_report {
+	std::vector<std::string> names;
+	size_t rows = 0;
+	std::vector<double> covariance;  // names.size() x names.size(), row-major
+	std::vector<double> correlation; // NaN where a column is constant
+	std::vector<std::pair<std::string, double>> target_ranking;
+};
+
+// Dot product of two contiguous columns with independent vector accumulators.
+double column_dot(const double* a, const double* b, size_t n) {
+	size_t k = 0;
+	double total = 0.0;
+#if defined(__AVX__)
+	__m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+	for (; k + 8 <= n; k += 8) {
+		acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + k), _mm256_loadu_pd(b + k)));
+		acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + k + 4), _mm256_loadu_pd(b + k + 4)));
+	}
+	alignas(32) double lanes[4];
+	_mm256_store_pd(lanes, _mm256_add_pd(acc0, acc1));
+	total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(FE_CORRELATION_SSE2)
+	__m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+	for (; k + 4 <= n; k += 4) {
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + k), _mm_loadu_pd(b + k)));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + k + 2), _mm_loadu_pd(b + k + 2)));
+	}
+	alignas(16) double lanes[2];
+	_mm_store_pd(lanes, _mm_add_pd(acc0, acc1));
+	total = lanes[0] + lanes[1];
+#else
+	double acc[4] = { 0.0, 0.0, 0.0, 0.0 };
+	for (; k + 4 <= n; k += 4) {
+		acc[0] += a[k] * b[k];
+		acc[1] += a[k + 1] * b[k + 1];
+		acc[2] += a[k + 2] * b[k + 2];
+		acc[3] += a[k + 3] * b[k + 3];
+	}
+	total = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#endif
+	for (; k < n; ++k) {
+		total += a[k] * b[k];
+	}
+	return total;
+}
+
+correlation_report correlation_analysis(dataframe& data, const std::vector<std::string>& features, const std::string& target) {
+	FE_PROFILE_SCOPE("correlation");
+	correlation_report report;
+
+	// Numeric columns only: key columns such as DATE/HOME/AWAY parse to all nulls and are skipped.
+	std::vector<numeric_column> columns;
+	for (const auto& name : features) {
+		if (!data.count(name) || std::find(report.names.begin(), report.names.end(), name) != report.names.end()) continue;
+		numeric_column column = data[name].to_numeric();
+		if (column.validity.count() == 0) continue;
+		if (!columns.empty() && column.values.size() != columns[0].values.size()) {
+			throw std::runtime_error("Column '" + name + "' has a different size than the first column. All columns must be the same length.");
+		}
+		report.names.push_back(name);
+		columns.push_back(std::move(column));
+	}
+	const size_t p = columns.size();
+	if (p == 0) return report;
+
+	validity_bitmap complete = columns[0].validity;
+	for (size_t j = 1; j < p; ++j) {
+		complete = complete & columns[j].validity;
+	}
+	std::vector<std::uint32_t> rows;
+	for (size_t i = 0; i < complete.size(); ++i) {
+		if (complete.test(i)) rows.push_back(static_cast<std::uint32_t>(i));
+	}
+	const size_t n = rows.size();
+	report.rows = n;
+
+	// Column-major matrix of complete rows, centered on each column's mean.
+	std::vector<double> x(p * n);
+	parallel_chunks(p, [&](size_t, size_t begin, size_t end) {
+		for (size_t j = begin; j < end; ++j) {
+			double* col = &x[j * n];
+			double sum = 0.0;
+			for (size_t k = 0; k < n; ++k) {
+				col[k] = columns[j].values[rows[k]];
+				sum += col[k];
+			}
+			const double avg = n ? sum / double(n) : 0.0;
+			for (size_t k = 0; k < n; ++k) {
+				col[k] -= avg;
+			}
+		}
+	});
+	columns.clear();
+
+	// Upper-triangle tiles of TILE x TILE columns, accumulated over row blocks that keep both
+	// tiles' slices in cache. Tiles are independent and spread over the workers.
+	constexpr size_t TILE = 8;
+	constexpr size_t ROW_BLOCK = 512;
+	const size_t tiles = (p + TILE - 1) / TILE;
+	std::vector<std::pair<size_t, size_t>> tile_pairs;
+	for (size_t ti = 0; ti < tiles; ++ti) {
+		for (size_t tj = ti; tj < tiles; ++tj) {
+			tile_pairs.emplace_back(ti, tj);
+		}
+	}
+	report.covariance.assign(p * p, 0.0);
+	const double scale = n > 1 ? 1.0 / double(n - 1) : std::numeric_limits<double>::quiet_NaN();
+	parallel_chunks(tile_pairs.size(), [&](size_t, size_t begin, size_t end) {
+		double acc[TILE][TILE];
+		for (size_t t = begin; t < end; ++t) {
+			const size_t i0 = tile_pairs[t].first * TILE, i1 = std::min(p, i0 + TILE);
+			const size_t j0 = tile_pairs[t].second * TILE, j1 = std::min(p, j0 + TILE);
+			for (auto& row : acc) std::fill(std::begin(row), std::end(row), 0.0);
+			for (size_t r0 = 0; r0 < n; r0 += ROW_BLOCK) {
+				const size_t len = std::min(ROW_BLOCK, n - r0);
+				for (size_t i = i0; i < i1; ++i) {
+					for (size_t j = std::max(j0, i); j < j1; ++j) {
+						acc[i - i0][j - j0] += column_dot(&x[i * n + r0], &x[j * n + r0], len);
+					}
+				}
+			}
+			for (size_t i = i0; i < i1; ++i) {
+				for (size_t j = std::max(j0, i); j < j1; ++j) {
+					report.covariance[i * p + j] = report.covariance[j * p + i] = acc[i - i0][j - j0] * scale;
+				}
+			}
+		}
+	});
+
+	report.correlation.assign(p * p, std::numeric_limits<double>::quiet_NaN());
+	for (size_t i = 0; i < p; ++i) {
+		for (size_t j = 0; j < p; ++j) {
+			double denom = std::sqrt(report.covariance[i * p + i] * report.covariance[j * p + j]);
+			if (denom > 0) report.correlation[i * p + j] = report.covariance[i * p + j] / denom;
+		}
+	}
+
+	auto target_it = std::find(report.names.begin(), report.names.end(), target);
+	if (target_it != report.names.end()) {
+		const size_t t = target_it - report.names.begin();
+		for (size_t j = 0; j < p; ++j) {
+			if (j != t && !std::isnan(report.correlation[t * p + j])) {
+				report.target_ranking.emplace_back(report.names[j], report.correlation[t * p + j]);
+			}
+		}
+		std::stable_sort(report.target_ranking.begin(), report.target_ranking.end(), [](const auto& a, const auto& b) {
+			return std::abs(a.second) > std::abs(b.second);
+		});
+	}
+	return report;
+}
+
+// Writes "<stem>_correlation.csv", "<stem>_covariance.csv" and "<stem>_target_correlation.csv".
+void save_correlation_report(const correlation_report& report, const std::string& stem) {
+	const size_t p = report.names.size();
+	auto write_matrix = [&](const std::vector<double>& matrix, const std::string& filename) {
+		std::ofstream file(filename);
+		if (!file.is_open()) {
+			throw std::runtime_error("Could not open file for writing: " + filename);
+		}
+		file << "FEATURE";
+		for (const auto& name : report.names) file << "," << name;
+		file << "\n";
+		for (size_t i = 0; i < p; ++i) {
+			file << report.names[i];
+			for (size_t j = 0; j < p; ++j) {
+				file << ",";
+				if (!std::isnan(matrix[i * p + j])) file << matrix[i * p + j];
+			}
+			file << "\n";
+		}
+	};
+	write_matrix(report.correlation, stem + "_correlation.csv");
+	write_matrix(report.covariance, stem + "_covariance.csv");
+
+	std::ofstream ranking(stem + "_target_correlation.csv");
+	if (!ranking.is_open()) {
+		throw std::runtime_error("Could not open file for writing: " + stem + "_target_correlation.csv");
+	}
+	ranking << "FEATURE,CORRELATION,ABS_CORRELATION\n";
+	for (const auto& [name, r] : report.target_ranking) {
+		ranking << name << "," << r << "," << std::abs(r) << "\n";
+	}
+	std::cout << "Correlation over " << p << " features and " << report.rows << " rows saved to " << stem << "_correlation.csv" << std::endl;
+}
@@ -3,10 +3,170 @@
 #include <map>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <iostream>
+#include <fstream>
 #include <unordered_map>
+#include <deque>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include "Profiler.h"
+
+
+// Packed per-row null mask: bit i is set when row i holds a usable number.
+// Combining masks is a word-wise AND, so null propagation stays vectorizable.
+class validity_bitmap {
+public:
+	validity_bitmap() = default;
+
+	explicit validity_bitmap(size_t size, bool value = true) : words((size + 63) / 64, value ? ~std::uint64_t{ 0 } : 0), bits(size) {
+		clear_tail();
+	}
 
+	size_t size() const {
+		return bits;
+	}
+
+	bool test(size_t idx) const {
+		return (words[idx >> 6] >> (idx & 63)) & 1u;
+	}
+
+	void set(size_t idx, bool value) {
+		std::uint64_t mask = std::uint64_t{ 1 } << (idx & 63);
+		if (value) words[idx >> 6] |= mask;
+		else words[idx >> 6] &= ~mask;
+	}
 
+	size_t count() const {
+		size_t total = 0;
+		for (std::uint64_t word : words) {
+			while (word) {
+				word &= word - 1;
+				++total;
+			}
+		}
+		return total;
+	}
+
+	bool all() const {
+		return count() == bits;
+	}
+
+	validity_bitmap operator&(const validity_bitmap& other) const {
+		if (other.bits != bits) {
+			throw std::runtime_error("Validity bitmaps must be the same length.");
+		}
+		validity_bitmap result(*this);
+		for (size_t i = 0; i < words.size(); ++i) {
+			result.words[i] &= other.words[i];
+		}
+		return result;
+	}
+
+private:
+	std::vector<std::uint64_t> words;
+	size_t bits = 0;
+
+	void clear_tail() {
+		if (bits % 64 != 0) {
+			words.back() &= (std::uint64_t{ 1 } << (bits % 64)) - 1;
+		}
+	}
+};
+
+// Parses a numeric cell without throwing. Surrounding blanks and a leading '+' are
+// tolerated; empty or malformed cells return false and leave value as NaN.
+bool parse_double(std::string_view text, double& value) {
+	value = std::numeric_limits<double>::quiet_NaN();
+	const char* first = text.data();
+	const char* last = first + text.size();
+	while (first < last && (*first == ' ' || *first == '\t')) ++first;
+	while (last > first && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r')) --last;
+	if (first < last && *first == '+') ++first;
+	if (first == last) return false;
+
+	double parsed = 0.0;
+	auto [ptr, ec] = std::from_chars(first, last, parsed);
+	if (ec != std::errc{} || ptr != last) return false;
+	value = parsed;
+	return true;
+}
+
+// Numbers parsed from a column. Null rows hold NaN and have their validity bit cleared.
+struct numeric_column {
+	std::vector<double> values;
+	validity_bitmap validity;
+};
+// Distinct values of a categorical column; a value's code is the order it was first seen in.
+// Values live in a deque so the lookup table can key on views of them. Those views point into
+// this object's own deque, so a copy rebuilds the table over its own values; a move takes the
+// deque's storage along and keeps them valid.
+class category_dictionary {
+public:
+	static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max();
+
+	category_dictionary() = default;
+
+	category_dictionary(const category_dictionary& other) : values(other.values) {
+		reindex();
+	}
+
+	category_dictionary& operator=(const category_dictionary& other) {
+		if (this != &other) {
+			values = other.values;
+			reindex();
+		}
+		return *this;
+	}
+
+	category_dictionary(category_dictionary&&) = default;
+	category_dictionary& operator=(category_dictionary&&) = default;
+
+	std::uint32_t encode(std::string_view value) {
+		auto it = codes.find(value);
+		if (it != codes.end()) return it->second;
+		std::uint32_t code = static_cast<std::uint32_t>(values.size());
+		values.emplace_back(value);
+		codes.emplace(values.back(), code);
+		return code;
+	}
+
+	// npos when the value has never been encoded.
+	std::uint32_t find(std::string_view value) const {
+		auto it = codes.find(value);
+		return it == codes.end() ? npos : it->second;
+	}
+
+	const std::string& operator[](std::uint32_t code) const {
+		return values[code];
+	}
+
+	size_t size() const {
+		return values.size();
+	}
+
+private:
+	std::deque<std::string> values;
+	std::unordered_map<std::string_view, std::uint32_t> codes;
+
+	void reindex() {
+		codes.clear();
+		codes.reserve(values.size());
+		for (size_t code = 0; code < values.size(); ++code) {
+			codes.emplace(values[code], static_cast<std::uint32_t>(code));
+		}
+	}
+};
+
+
+// A column of cells. Columns with few distinct values (dates, team names) can be held
+// categorical: one shared dictionary plus a 32-bit code per row, decoded only when read.
 class string_vector {
 public:
 	string_vector() = default;
@@ -15,130 +175,143 @@ public:
 
 	string_vector(size_t size, const std::string& value = std::string()) : vec_str(size, value) {}
 
+	string_vector(std::shared_ptr<const category_dictionary> dictionary, std::vector<std::uint32_t> codes)
+		: dictionary(std::move(dictionary)), category_codes(std::move(codes)) {}
+
 	size_t size() const {
-		return vec_str.size();
+		return dictionary ? category_codes.size() : vec_str.size();
 	}
 
+	// Writing through a categorical column turns it back into plain strings.
 	std::string& operator[](size_t idx) {
+		if (dictionary) decode_in_place();
 		return vec_str[idx];
 	}
 
 	const std::string& operator[](size_t index) const {
-		return vec_str[index];
+		return dictionary ? (*dictionary)[category_codes[index]] : vec_str[index];
 	}
 
 	void push_back(const std::string& value) {
+		if (dictionary) decode_in_place();
 		vec_str.push_back(value);
 	}
 
 	const std::vector<std::string>& get_data() const {
+		if (dictionary) {
+			throw std::runtime_error("get_data: column is categorical; read it with operator[] or decoded().");
+		}
 		return vec_str;
 	}
 
-	std::vector<double> to_float() const {
-		std::vector<double> result = as_float(this->vec_str);
-		if (result.size() != this->vec_str.size()) {
-			throw std::runtime_error("to_float conversion resulted in a vector of different size");
+	bool is_categorical() const {
+		return dictionary != nullptr;
+	}
+
+	const std::vector<std::uint32_t>& codes() const {
+		return category_codes;
+	}
+
+	const category_dictionary& categories() const {
+		return *dictionary;
+	}
+
+	// Categorical copy of the column (itself if it already is one).
+	string_vector encoded() const {
+		if (dictionary) return *this;
+		auto categories = std::make_shared<category_dictionary>();
+		std::vector<std::uint32_t> codes(vec_str.size());
+		for (size_t i = 0; i < vec_str.size(); ++i) {
+			codes[i] = categories->encode(vec_str[i]);
 		}
+		return string_vector(std::move(categories), std::move(codes));
+	}
+
+	string_vector decoded() const {
+		string_vector result(*this);
+		if (result.dictionary) result.decode_in_place();
 		return result;
 	}
 
-	string_vector operator+(const string_vector& other) const {
-		std::ostringstream stream;
-		std::vector<double> vec1 = as_float(vec_str);
-		std::vector<double> vec2 = as_float(other.vec_str);
-		check_size(vec1, vec2);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			stream << vec1[i] + vec2[i];
-			result[i] = stream.str();
-			stream.str("");
+	// A categorical column parses each distinct value once.
+	numeric_column to_numeric() const {
+		FE_PROFILE_SCOPE("string_vector::to_numeric");
+		numeric_column result{ std::vector<double>(size()), validity_bitmap(size()) };
+		if (dictionary) {
+			std::vector<double> parsed(dictionary->size());
+			std::vector<std::uint8_t> ok(dictionary->size());
+			for (std::uint32_t c = 0; c < dictionary->size(); ++c) {
+				ok[c] = parse_double((*dictionary)[c], parsed[c]);
+			}
+			for (size_t i = 0; i < category_codes.size(); ++i) {
+				result.values[i] = parsed[category_codes[i]];
+				if (!ok[category_codes[i]]) result.validity.set(i, false);
+			}
+			return result;
+		}
+		for (size_t i = 0; i < vec_str.size(); ++i) {
+			if (!parse_double(vec_str[i], result.values[i])) {
+				result.validity.set(i, false);
+			}
 		}
 		return result;
 	}
 
+	// Always the same length as the column; null cells come back as NaN.
+	std::vector<double> to_float() const {
+		return to_numeric().values;
+	}
+
+	validity_bitmap validity() const {
+		return to_numeric().validity;
+	}
+
+	size_t null_count() const {
+		return size() - validity().count();
+	}
+
+	string_vector operator+(const string_vector& other) const {
+		return elementwise(other, [](double a, double b) { return a + b; });
+	}
+
 	string_vector operator-(const string_vector& other) const {
-		std::ostringstream stream;
-		std::vector<double> vec1 = as_float(vec_str);
-		std::vector<double> vec2 = as_float(other.vec_str);
-		check_size(vec1, vec2);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			stream << vec1[i] - vec2[i];
-			result[i] = stream.str();
-			stream.str("");
-		}
-		return result;
+		return elementwise(other, [](double a, double b) { return a - b; });
 	}
 
 	string_vector operator*(const string_vector& other) const {
-		std::ostringstream stream;
-		std::vector<double> vec1 = as_float(vec_str);
-		std::vector<double> vec2 = as_float(other.vec_str);
-		check_size(vec1, vec2);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			stream << vec1[i] * vec2[i];
-			result[i] = stream.str();
-			stream.str("");
-		}
-		return result;
+		return elementwise(other, [](double a, double b) { return a * b; });
 	}
 
 	string_vector operator/(const string_vector& other) const {
-		std::ostringstream stream;
-		std::vector<double> vec1 = as_float(vec_str);
-		std::vector<double> vec2 = as_float(other.vec_str);
-		check_size(vec1, vec2);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			if (vec2[i] == 0) {
+		numeric_column lhs = to_numeric();
+		numeric_column rhs = other.to_numeric();
+		check_size(lhs.values, rhs.values);
+		validity_bitmap valid = lhs.validity & rhs.validity;
+		for (size_t i = 0; i < rhs.values.size(); ++i) {
+			if (rhs.values[i] == 0 && valid.test(i)) {
 				throw std::runtime_error("Division by zero in element-wise vector operation.");
 			}
-			stream << vec1[i] / (double)vec2[i];
-			result[i] = stream.str();
-			stream.str("");
 		}
-		return result;
+		std::vector<double> result(lhs.values.size());
+		for (size_t i = 0; i < result.size(); ++i) {
+			result[i] = lhs.values[i] / rhs.values[i];
+		}
+		return from_numeric(result, valid);
 	}
 
 	// Addition (vector + scalar)
 	string_vector operator+(const double& scalar) const {
-		std::ostringstream stream;
-		std::vector<double> vec1 = as_float(vec_str);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			stream << vec1[i] + scalar;
-			result[i] = stream.str();
-			stream.str("");
-		}
-		return result;
+		return scalar_op([scalar](double a) { return a + scalar; });
 	}
 
 	// Subtraction (vector - scalar)
 	string_vector operator-(const double& scalar) const {
-		std::ostringstream stream;
-		std::vector<double> vec1 = as_float(vec_str);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			stream << vec1[i] - scalar;
-			result[i] = stream.str();
-			stream.str("");
-		}
-		return result;
+		return scalar_op([scalar](double a) { return a - scalar; });
 	}
 
 	// Multiplication (vector * scalar)
 	string_vector operator*(const double& scalar) const {
-		std::ostringstream stream;
-		std::vector<double> vec1 = as_float(vec_str);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			stream << vec1[i] * scalar;
-			result[i] = stream.str();
-			stream.str("");
-		}
-		return result;
+		return scalar_op([scalar](double a) { return a * scalar; });
 	}
 
 	// Division (vector / scalar)
@@ -146,95 +319,86 @@ public:
 		if (scalar == 0) {
 			throw std::runtime_error("Division by zero in vector/scalar operation.");
 		}
-		std::ostringstream stream;
-		std::vector<double> vec1 = as_float(vec_str);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			stream << vec1[i] / (double)scalar;
-			result[i] = stream.str();
-			stream.str("");
-		}
-		return result;
+		return scalar_op([scalar](double a) { return a / scalar; });
 	}
 
 	string_vector operator<(const double& scalar) const {
-		std::ostringstream stream;
-		std::vector<double> vec1 = as_float(vec_str);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			result[i] = (vec1[i] < scalar) ? "1" : "0";
-		}
-		return result;
+		return compare([scalar](double a) { return a < scalar; });
 	}
 
 	string_vector operator>(const double& scalar) const {
-		std::ostringstream stream;
-		std::vector<double> vec1 = as_float(vec_str);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			result[i] = (vec1[i] > scalar) ? "1" : "0";
-		}
-		return result;
+		return compare([scalar](double a) { return a > scalar; });
 	}
 
 	string_vector operator<=(const double& scalar) const {
-		std::vector<double> vec1 = as_float(vec_str);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			result[i] = (vec1[i] <= scalar) ? "1" : "0";
-		}
-		return result;
+		return compare([scalar](double a) { return a <= scalar; });
 	}
 
 	string_vector operator>=(const double& scalar) const {
-		std::vector<double> vec1 = as_float(vec_str);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			result[i] = (vec1[i] >= scalar) ? "1" : "0";
-		}
-		return result;
+		return compare([scalar](double a) { return a >= scalar; });
 	}
 
 	string_vector operator==(const double& scalar) const {
-		std::vector<double> vec1 = as_float(vec_str);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			result[i] = (std::abs(vec1[i] - scalar) < 1e-9) ? "1" : "0";
-		}
-		return result;
+		return compare([scalar](double a) { return std::abs(a - scalar) < 1e-9; });
 	}
 
 	string_vector operator!=(const double& scalar) const {
-		std::vector<double> vec1 = as_float(vec_str);
-		string_vector result(vec1.size());
-		for (size_t i = 0; i < vec1.size(); ++i) {
-			result[i] = (std::abs(vec1[i] - scalar) >= 1e-9) ? "1" : "0";
-		}
-		return result;
+		return compare([scalar](double a) { return std::abs(a - scalar) >= 1e-9; });
+	}
+
+	// Exact match against a value ("1"/"0", nulls stay null). Categorical columns look the
+	// value up once and compare codes.
+	string_vector operator==(const std::string& value) const {
+		return match(value, true);
 	}
 
+	string_vector operator!=(const std::string& value) const {
+		return match(value, false);
+	}
+
+	// Logical operators work on "1"/"0" flag columns; an empty cell is null and stays null.
 	string_vector operator&&(const string_vector& other) const {
-		if (other.size() != vec_str.size()) {
+		FE_PROFILE_SCOPE("string_vector::logical");
+		if (other.size() != size()) {
 			std::cout << "ERROR: Size mismatch during vector operation!\n";
 			exit(1);
 		}
-		string_vector result(vec_str.size());
+		const string_vector& self = *this;
+		string_vector result(size());
 
 		for (size_t i = 0; i < result.size(); ++i) {
-			result[i] = (vec_str[i] == "1" && other[i] == "1") ? "1" : "0";
+			if (self[i].empty() || other[i].empty()) continue;
+			result[i] = (self[i] == "1" && other[i] == "1") ? "1" : "0";
 		}
 		return result;
 	}
 
 	string_vector operator||(const string_vector& other) const {
-		if (other.size() != vec_str.size()) {
+		FE_PROFILE_SCOPE("string_vector::logical");
+		if (other.size() != size()) {
 			std::cout << "ERROR: Size mismatch during vector operation!\n";
 			exit(1);
 		}
-		string_vector result(vec_str.size());
+		const string_vector& self = *this;
+		string_vector result(size());
 
 		for (size_t i = 0; i < result.size(); ++i) {
-			result[i] = (vec_str[i] == "1" || other[i] == "1") ? "1" : "0";
+			if (self[i].empty() || other[i].empty()) continue;
+			result[i] = (self[i] == "1" || other[i] == "1") ? "1" : "0";
+		}
+		return result;
+	}
+
+	// Formats computed values back into a column; rows whose validity bit is clear become empty (null) cells.
+	static string_vector from_numeric(const std::vector<double>& values, const validity_bitmap& valid) {
+		FE_PROFILE_SCOPE("string_vector::from_numeric");
+		std::ostringstream stream;
+		string_vector result(values.size());
+		for (size_t i = 0; i < values.size(); ++i) {
+			if (!valid.test(i)) continue;
+			stream << values[i];
+			result[i] = stream.str();
+			stream.str("");
 		}
 		return result;
 	}
@@ -242,6 +406,36 @@ public:
 
 private:
 	std::vector<std::string> vec_str;
+	std::shared_ptr<const category_dictionary> dictionary;
+	std::vector<std::uint32_t> category_codes;
+
+	void decode_in_place() {
+		vec_str.resize(category_codes.size());
+		for (size_t i = 0; i < category_codes.size(); ++i) {
+			vec_str[i] = (*dictionary)[category_codes[i]];
+		}
+		dictionary.reset();
+		category_codes = {};
+	}
+
+	string_vector match(const std::string& value, bool equal) const {
+		FE_PROFILE_SCOPE("string_vector::match");
+		string_vector result(size());
+		if (dictionary) {
+			const std::uint32_t code = dictionary->find(value);
+			const std::uint32_t null_code = dictionary->find("");
+			for (size_t i = 0; i < category_codes.size(); ++i) {
+				if (category_codes[i] == null_code) continue;
+				result[i] = ((category_codes[i] == code) == equal) ? "1" : "0";
+			}
+			return result;
+		}
+		for (size_t i = 0; i < vec_str.size(); ++i) {
+			if (vec_str[i].empty()) continue;
+			result[i] = ((vec_str[i] == value) == equal) ? "1" : "0";
+		}
+		return result;
+	}
 
 	void check_size(const std::vector<double>& vec1, const std::vector<double>& vec2) const {
 		if (vec1.size() != vec2.size()) {
@@ -249,18 +443,39 @@ private:
 		}
 	}
 
-	std::vector<double> as_float(const std::vector<std::string>& vec) const {
-		std::vector<double> result;
-		result.reserve(vec.size());
-		for (const auto& elem : vec) {
-			double value = 0.0;
-			try {
-				value = elem.empty() ? -1.0 : std::stod(elem);
-				result.push_back(value);
-			}
-			catch (const std::exception&) {
-				continue;
-			}
+	// The arithmetic loops run over every row unconditionally (null rows carry NaN),
+	// so they vectorize; the validity mask decides afterwards which results are kept.
+	template <typename Op>
+	string_vector elementwise(const string_vector& other, Op op) const {
+		FE_PROFILE_SCOPE("string_vector::arithmetic");
+		numeric_column lhs = to_numeric();
+		numeric_column rhs = other.to_numeric();
+		check_size(lhs.values, rhs.values);
+		std::vector<double> result(lhs.values.size());
+		for (size_t i = 0; i < result.size(); ++i) {
+			result[i] = op(lhs.values[i], rhs.values[i]);
+		}
+		return from_numeric(result, lhs.validity & rhs.validity);
+	}
+
+	template <typename Op>
+	string_vector scalar_op(Op op) const {
+		FE_PROFILE_SCOPE("string_vector::arithmetic");
+		numeric_column column = to_numeric();
+		for (double& value : column.values) {
+			value = op(value);
+		}
+		return from_numeric(column.values, column.validity);
+	}
+
+	template <typename Pred>
+	string_vector compare(Pred pred) const {
+		FE_PROFILE_SCOPE("string_vector::compare");
+		numeric_column column = to_numeric();
+		string_vector result(column.values.size());
+		for (size_t i = 0; i < column.values.size(); ++i) {
+			if (!column.validity.test(i)) continue;
+			result[i] = pred(column.values[i]) ? "1" : "0";
 		}
 		return result;
 	}
@@ -278,7 +493,7 @@ public:
 		return index != other.index;
 	}
 	std::string const& operator* () const {
-		return vec[index];
+		return static_cast<const string_vector&>(vec)[index];
 	}
 	string_vector_iterator& operator++() {
 		++index;
@@ -300,20 +515,19 @@ string_vector_iterator end(string_vector& vec) {
 }
 
 string_vector apply_function(const string_vector& vec, double(*func)(double)) {
-	string_vector result(vec.size());
-	std::vector<double> num_vec = vec.to_float();
-	std::ostringstream stream("");
-	for (int i = 0; i < num_vec.size(); ++i) {
-		stream << func(num_vec[i]);
-		result[i] = stream.str();
-		stream.str("");
-	}
-	return result;
+	numeric_column column = vec.to_numeric();
+	for (size_t i = 0; i < column.values.size(); ++i) {
+		column.values[i] = func(column.values[i]);
+	}
+	return string_vector::from_numeric(column.values, column.validity);
 }
 
 using dataframe = std::unordered_map<std::string, string_vector>;
 
-dataframe load_data(const std::string& filename) {
+// Columns named in `categorical` are dictionary-encoded while loading, so their values are
+// stored once per distinct value rather than once per row.
+dataframe load_data(const std::string& filename, const std::vector<std::string>& categorical = {}) {
+	FE_PROFILE_SCOPE("load_data");
 	auto split = [](const std::string& str, char delimiter) {
 		std::vector<std::string> fields;
 		std::stringstream ss(str);
@@ -336,18 +550,159 @@ dataframe load_data(const std::string& filename) {
 		header_names.push_back(key);
 		spreadsheet[key] = string_vector{};
 	}
+	std::vector<std::shared_ptr<category_dictionary>> dictionaries(header_names.size());
+	std::vector<std::vector<std::uint32_t>> codes(header_names.size());
+	for (size_t i{ 0 }; i < header_names.size(); ++i) {
+		if (std::find(categorical.begin(), categorical.end(), header_names[i]) != categorical.end()) {
+			dictionaries[i] = std::make_shared<category_dictionary>();
+		}
+	}
 
 	while (std::getline(file, line)) {
 		std::vector<std::string> row = split(line, ',');
-		for (size_t i{ 0 }; i < row.size(); ++i) {
-			spreadsheet[header_names[i]].push_back(row[i]);
+		// Short rows (missing trailing cells) are padded with nulls so every column keeps row alignment.
+		for (size_t i{ 0 }; i < header_names.size(); ++i) {
+			const std::string& cell = i < row.size() ? row[i] : std::string{};
+			if (dictionaries[i]) {
+				codes[i].push_back(dictionaries[i]->encode(cell));
+			}
+			else {
+				spreadsheet[header_names[i]].push_back(cell);
+			}
+		}
+	}
+	for (size_t i{ 0 }; i < header_names.size(); ++i) {
+		if (dictionaries[i]) {
+			spreadsheet[header_names[i]] = string_vector(std::move(dictionaries[i]), std::move(codes[i]));
 		}
 	}
 	return spreadsheet;
 	file.close();
 }
 
-void save_to_csv(dataframe& data, const std::string& filename, const std::vector<std::string>& features) {
+// Sorted indices of the rows a view keeps. Slicing the data many ways costs one of these
+// per slice instead of a copy of every column.
+using selection_vector = std::vector<std::uint32_t>;
+
+// Rows whose flag cell is "1" (the output of comparisons and &&/||); nulls are not selected.
+selection_vector filter(const string_vector& mask) {
+	selection_vector rows;
+	for (size_t i = 0; i < mask.size(); ++i) {
+		if (mask[i] == "1") rows.push_back(static_cast<std::uint32_t>(i));
+	}
+	return rows;
+}
+
+// Rows whose cell equals `value` exactly, e.g. one SEASON or one HOME team.
+selection_vector select_equal(const string_vector& column, const std::string& value) {
+	selection_vector rows;
+	if (column.is_categorical()) {
+		const std::uint32_t code = column.categories().find(value);
+		if (code == category_dictionary::npos) return rows;
+		const std::vector<std::uint32_t>& codes = column.codes();
+		for (size_t i = 0; i < codes.size(); ++i) {
+			if (codes[i] == code) rows.push_back(static_cast<std::uint32_t>(i));
+		}
+		return rows;
+	}
+	for (size_t i = 0; i < column.size(); ++i) {
+		if (column[i] == value) rows.push_back(static_cast<std::uint32_t>(i));
+	}
+	return rows;
+}
+
+selection_vector intersect(const selection_vector& a, const selection_vector& b) {
+	selection_vector rows;
+	std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(rows));
+	return rows;
+}
+
+// One column seen through a view's selection; row i is source row selection[i].
+class column_view {
+public:
+	column_view(const string_vector& column, const selection_vector* rows) : column(&column), rows(rows) {}
+
+	size_t size() const {
+		return rows ? rows->size() : column->size();
+	}
+
+	const std::string& operator[](size_t idx) const {
+		return (*column)[rows ? (*rows)[idx] : idx];
+	}
+
+	string_vector materialize() const {
+		string_vector result(size());
+		for (size_t i = 0; i < size(); ++i) {
+			result[i] = (*this)[i];
+		}
+		return result;
+	}
+
+private:
+	const string_vector* column;
+	const selection_vector* rows;
+};
+
+// A dataframe restricted to a subset of its rows. The selection is applied lazily: columns are
+// never copied, and operators that accept a view only visit the selected rows. The view keeps a
+// reference to the dataframe, which must outlive it.
+class dataframe_view {
+public:
+	explicit dataframe_view(dataframe& data) : data(&data) {}
+
+	dataframe_view(dataframe& data, selection_vector rows)
+		: data(&data), rows(std::make_shared<const selection_vector>(std::move(rows))) {}
+
+	// Narrows the view to rows where `flag_column` is "1".
+	dataframe_view where(const std::string& flag_column) const {
+		return where(filter(column(flag_column)));
+	}
+
+	dataframe_view where(const selection_vector& selected) const {
+		return dataframe_view(*data, rows ? intersect(*rows, selected) : selected);
+	}
+
+	size_t size() const {
+		return rows ? rows->size() : (data->empty() ? 0 : data->begin()->second.size());
+	}
+
+	column_view operator[](const std::string& name) const {
+		return column_view(column(name), selection());
+	}
+
+	dataframe& source() const {
+		return *data;
+	}
+
+	// nullptr when the view covers every row.
+	const selection_vector* selection() const {
+		return rows.get();
+	}
+
+	dataframe materialize(const std::vector<std::string>& columns) const {
+		dataframe result;
+		for (const auto& name : columns) {
+			result[name] = (*this)[name].materialize();
+		}
+		return result;
+	}
+
+private:
+	dataframe* data;
+	std::shared_ptr<const selection_vector> rows;
+
+	const string_vector& column(const std::string& name) const {
+		auto it = data->find(name);
+		if (it == data->end()) {
+			throw std::runtime_error("No column named '" + name + "'");
+		}
+		return it->second;
+	}
+};
+
+// Writes the `features` columns; with `rows`, only those rows (in order).
+void save_to_csv(dataframe& data, const std::string& filename, const std::vector<std::string>& features, const selection_vector* rows = nullptr) {
+	FE_PROFILE_SCOPE("save_to_csv");
 	if (data.empty()) {
 		std::cerr << "Warning: Dataframe is empty. Nothing saved to file." << std::endl;
 		return;
@@ -358,7 +713,7 @@ void save_to_csv(dataframe& data, const std::string& filename, const std::vector
 		throw std::runtime_error("Could not open file for writing: " + filename);
 	}
 
-	std::vector<std::pair<std::string, const std::vector<std::string>*>> columns;
+	std::vector<std::pair<std::string, const string_vector*>> columns;
 	size_t row_count = 0;
 	bool first_column = true;
 
@@ -371,7 +726,7 @@ void save_to_csv(dataframe& data, const std::string& filename, const std::vector
 		else if (data[key].size() != row_count) {
 			throw std::runtime_error("Column '" + key + "' has a different size than the first column. All columns must be the same length.");
 		}
-		columns.push_back({ key, &data[key].get_data() });
+		columns.push_back({ key, &data[key] });
 	}
 
 	// Write the Header Row
@@ -383,10 +738,18 @@ void save_to_csv(dataframe& data, const std::string& filename, const std::vector
 	}
 	file << "\n";
 
+	if (rows) {
+		if (!rows->empty() && rows->back() >= row_count) {
+			throw std::runtime_error("Row selection is out of range for " + filename);
+		}
+		row_count = rows->size();
+	}
+
 	// Write Data Rows
 	for (size_t i = 0; i < row_count; ++i) {
+		const size_t r = rows ? (*rows)[i] : i;
 		for (size_t j = 0; j < columns.size(); ++j) {
-			file << (*columns[j].second)[i];
+			file << (*columns[j].second)[r];
 
 			if (j < columns.size() - 1) {
 				file << ",";
@@ -396,4 +759,123 @@ void save_to_csv(dataframe& data, const std::string& filename, const std::vector
 	}
 
 	std::cout << "Successfully saved " << row_count << " rows to " << filename << std::endl;
-}
\ No newline at end of file
+}
+
+enum class npy_dtype { float32, float64 };
+enum class npy_order { row_major, column_major };
+
+// Writes the numeric `features` as one rows x features matrix in NumPy .npy format, so
+// training code can np.load(..., mmap_mode="r") it without parsing. Nulls become NaN.
+// The string key columns go to "<stem>_keys.csv" and the feature names, in matrix
+// column order, to "<stem>_columns.txt".
+void save_to_npy(dataframe& data, const std::string& filename, const std::vector<std::string>& features,
+	npy_dtype dtype = npy_dtype::float32, npy_order order = npy_order::row_major,
+	const std::vector<std::string>& key_columns = { "DATE", "HOME", "AWAY" }, const selection_vector* rows = nullptr) {
+	FE_PROFILE_SCOPE("save_to_npy");
+
+	if (data.empty()) {
+		std::cerr << "Warning: Dataframe is empty. Nothing saved to file." << std::endl;
+		return;
+	}
+
+	std::vector<std::string> names;
+	for (const auto& key : features) {
+		if (std::find(key_columns.begin(), key_columns.end(), key) == key_columns.end()) {
+			names.push_back(key);
+		}
+	}
+	std::vector<std::vector<double>> columns(names.size());
+	size_t row_count = names.empty() ? 0 : data[names[0]].size();
+	for (size_t j = 0; j < names.size(); ++j) {
+		if (data[names[j]].size() != row_count) {
+			throw std::runtime_error("Column '" + names[j] + "' has a different size than the first column. All columns must be the same length.");
+		}
+		columns[j] = data[names[j]].to_float();
+		if (rows) {
+			std::vector<double> selected(rows->size());
+			for (size_t i = 0; i < rows->size(); ++i) {
+				selected[i] = columns[j].at((*rows)[i]);
+			}
+			columns[j] = std::move(selected);
+		}
+	}
+	if (rows) row_count = rows->size();
+
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("Could not open file for writing: " + filename);
+	}
+
+	const std::uint16_t probe = 1;
+	const bool little_endian = *reinterpret_cast<const unsigned char*>(&probe) == 1;
+	std::ostringstream header;
+	header << "{'descr': '" << (little_endian ? '<' : '>') << (dtype == npy_dtype::float32 ? "f4" : "f8")
+		<< "', 'fortran_order': " << (order == npy_order::column_major ? "True" : "False")
+		<< ", 'shape': (" << row_count << ", " << names.size() << "), }";
+	// Magic (6) + version (2) + length (2) + dictionary must be a multiple of 64 bytes, ending in '\n'.
+	std::string dict = header.str();
+	dict.append(63 - (10 + dict.size()) % 64, ' ');
+	dict.push_back('\n');
+	const std::uint16_t header_len = static_cast<std::uint16_t>(dict.size());
+	file.write("\x93NUMPY\x01\x00", 8);
+	const char len_bytes[2] = { static_cast<char>(header_len & 0xFF), static_cast<char>(header_len >> 8) };
+	file.write(len_bytes, 2);
+	file.write(dict.data(), dict.size());
+
+	// Values are staged in a block buffer so the file sees a few large writes.
+	auto write_values = [&file, dtype](const auto& value_at, size_t count) {
+		const size_t block = 1 << 14;
+		std::vector<float> f32;
+		std::vector<double> f64;
+		for (size_t begin = 0; begin < count; begin += block) {
+			size_t end = std::min(count, begin + block);
+			if (dtype == npy_dtype::float32) {
+				f32.resize(end - begin);
+				for (size_t k = begin; k < end; ++k) f32[k - begin] = static_cast<float>(value_at(k));
+				file.write(reinterpret_cast<const char*>(f32.data()), f32.size() * sizeof(float));
+			}
+			else {
+				f64.resize(end - begin);
+				for (size_t k = begin; k < end; ++k) f64[k - begin] = value_at(k);
+				file.write(reinterpret_cast<const char*>(f64.data()), f64.size() * sizeof(double));
+			}
+		}
+	};
+	const size_t cols = names.size();
+	if (order == npy_order::row_major) {
+		write_values([&columns, cols](size_t k) { return columns[k % cols][k / cols]; }, row_count * cols);
+	}
+	else {
+		for (const auto& column : columns) {
+			write_values([&column](size_t k) { return column[k]; }, row_count);
+		}
+	}
+	if (!file) {
+		throw std::runtime_error("Failed writing matrix to " + filename);
+	}
+
+	std::string stem = filename.substr(0, filename.find_last_of('.'));
+	std::ofstream names_file(stem + "_columns.txt");
+	for (const auto& name : names) {
+		names_file << name << "\n";
+	}
+	std::vector<std::string> present_keys;
+	for (const auto& key : key_columns) {
+		if (data.count(key)) present_keys.push_back(key);
+	}
+	if (!present_keys.empty()) {
+		save_to_csv(data, stem + "_keys.csv", present_keys, rows);
+	}
+
+	std::cout << "Successfully saved " << row_count << " x " << cols << " matrix to " << filename << std::endl;
+}
+
+void save_to_csv(const dataframe_view& view, const std::string& filename, const std::vector<std::string>& features) {
+	save_to_csv(view.source(), filename, features, view.selection());
+}
+
+void save_to_npy(const dataframe_view& view, const std::string& filename, const std::vector<std::string>& features,
+	npy_dtype dtype = npy_dtype::float32, npy_order order = npy_order::row_major,
+	const std::vector<std::string>& key_columns = { "DATE", "HOME", "AWAY" }) {
+	save_to_npy(view.source(), filename, features, dtype, order, key_columns, view.selection());
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <regex>
+#include <charconv>
+#include <iostream>
+#include "DataFrame.h"
+
+bool is_leap_year(int y) {
+    return (y % 4 == 0 && y % 100 != 0) || (y % 400 == 0);
+}
+
+// Days since 01.01.0001 (proleptic Gregorian), so differences between two dates are plain subtraction.
+long long day_number(int day, int month, int year) {
+    long long y = year - 1;
+
+    long long day_count = y * 365LL;
+    day_count += y / 4 - y / 100 + y / 400;
+
+    static const int DAYS_IN_MONTH[12] = { 31,28,31,30,31,30,31,31,30,31,30,31 };
+
+    for (int m = 1; m < month; ++m)
+        day_count += DAYS_IN_MONTH[m - 1];
+
+    if (month > 2 && is_leap_year(year))
+        day_count += 1;
+
+    day_count += day;
+    return day_count;
+}
+
+// Reads the "dd.mm.yyyy." cells written by modify_dates without regex or exceptions.
+bool parse_date(std::string_view text, int& day, int& month, int& year) {
+    if (text.size() < 10 || text[2] != '.' || text[5] != '.') return false;
+    const char* s = text.data();
+    if (std::from_chars(s, s + 2, day).ptr != s + 2) return false;
+    if (std::from_chars(s + 3, s + 5, month).ptr != s + 5) return false;
+    if (std::from_chars(s + 6, s + 10, year).ptr != s + 10) return false;
+    return day >= 1 && day <= 31 && month >= 1 && month <= 12;
+}
+
+// Day number of a "dd.mm.yyyy." cell, or -1 when the cell is not a date.
+long long day_number(std::string_view text) {
+    int day, month, year;
+    if (!parse_date(text, day, month, year)) return -1;
+    return day_number(day, month, year);
+}
+
+// Season label ("2019-2020") for a "dd.mm.yyyy." cell. Uses the same September
+// cut-over as modify_dates; returns an empty string for cells that are not dates.
+std::string season_of(std::string_view text) {
+    int day, month, year;
+    if (!parse_date(text, day, month, year)) return std::string{};
+    int start = (month > 8) ? year : year - 1;
+    return std::to_string(start) + "-" + std::to_string(start + 1);
+}
+
+// Categorical dates give a categorical season column, mapped once per distinct date.
+string_vector season_column(const string_vector& dates) {
+    if (dates.is_categorical()) {
+        auto seasons = std::make_shared<category_dictionary>();
+        std::vector<std::uint32_t> date_season(dates.categories().size());
+        for (std::uint32_t c = 0; c < date_season.size(); ++c) {
+            date_season[c] = seasons->encode(season_of(dates.categories()[c]));
+        }
+        std::vector<std::uint32_t> codes(dates.size());
+        for (size_t i = 0; i < codes.size(); ++i) {
+            codes[i] = date_season[dates.codes()[i]];
+        }
+        return string_vector(std::move(seasons), std::move(codes));
+    }
+    string_vector result(dates.size());
+    for (size_t i = 0; i < dates.size(); ++i) {
+        result[i] = season_of(dates[i]);
+    }
+    return result;
+}
+
+class Date {
+private:
+    int day{};
+    int month{};
+    int year{};
+    std::string date_str{};
+
+    std::tuple<int, int, int, int> split_date(const std::string& date_str) {
+        const std::regex datePattern("(\\d{2})\\.(\\d{2})\\.(\\d{4}).");
+        std::smatch matches;
+
+        if (std::regex_match(date_str, matches, datePattern)) {
+            try {
+                int day_val = std::stoi(matches[1].str());
+                int month_val = std::stoi(matches[2].str());
+                int year_val = std::stoi(matches[3].str());
+
+                return std::make_tuple(day_val, month_val, year_val, 0);
+            }
+            catch (const std::exception& e) {
+                return std::make_tuple(0, 0, 0, 1);
+            }
+        }
+        return std::make_tuple(0, 0, 0, 1);
+    }
+
+    long long to_day_number() const {
+        return day_number(day, month, year);
+    }
+
+    bool operator> (const Date& other) const {
+        if (year != other.year) return year > other.year;
+        if (month != other.month) return month > other.month;
+        return day > other.day;
+    }
+
+public:
+    Date() {
+        day = month = year = 0;
+        date_str = "";
+    }
+
+    void set_date(const std::string& date_str_in) {
+        this->date_str = date_str_in;
+        auto [d, m, y, err] = split_date(date_str_in);
+
+        if (err == 0) {
+            this->day = d;
+            this->month = m;
+            this->year = y;
+        }
+        else {
+            this->day = this->month = this->year = 0;
+            std::cout << "Error: Invalid date format or structure provided: " << date_str_in << std::endl;
+        }
+    }
+
+    int operator-(const Date& other) const {
+        if (!(*this > other)) return 0;
+        long long days1 = this->to_day_number();
+        long long days2 = other.to_day_number();
+        return static_cast<int>(days1 - days2);
+    }
+};
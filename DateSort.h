@@ -0,0 +1,161 @@
+#pragma once
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Date.h"
+#include "Profiler.h"
+
+enum class date_order { ascending, descending };
+
+// Rows held in memory at once before sort_by_date spills sorted runs to disk.
+constexpr size_t DATE_SORT_MEMORY = size_t{ 256 } << 20;
+
+// Sort key of a data row: the day number of its first field (DATE), then its second (HOME).
+struct date_key {
+	long long day;
+	std::string team;
+};
+
+date_key row_date_key(std::string_view line, const std::string& filename) {
+	size_t first = line.find(',');
+	std::string_view date = line.substr(0, first);
+	long long day = day_number(date);
+	if (day < 0) {
+		throw std::runtime_error("Date sort: invalid date '" + std::string(date) + "' in " + filename);
+	}
+	std::string_view team = (first == std::string_view::npos) ? std::string_view{} : line.substr(first + 1);
+	return { day, std::string(team.substr(0, team.find(','))) };
+}
+
+bool date_key_before(const date_key& a, const date_key& b, date_order order) {
+	if (a.day != b.day) return (order == date_order::ascending) ? a.day < b.day : a.day > b.day;
+	return (order == date_order::ascending) ? a.team < b.team : a.team > b.team;
+}
+
+// True when the data rows' dates already follow `order` (ties in any team order).
+bool in_date_order(const std::string& filename, date_order order) {
+	std::ifstream file{ filename, std::ios::binary };
+	if (!file.is_open()) {
+		throw std::runtime_error("Date sort: could not open " + filename);
+	}
+	std::string line;
+	std::getline(file, line);
+	long long previous = -1;
+	while (std::getline(file, line)) {
+		if (line.empty()) continue;
+		long long day = row_date_key(line, filename).day;
+		if (previous >= 0 && ((order == date_order::ascending) ? day < previous : day > previous)) return false;
+		previous = day;
+	}
+	return true;
+}
+
+// Sorts the data rows of a CSV that starts with DATE ("dd.mm.yyyy.") and HOME by (day, team)
+// in `order`, in place; the header stays first and blank lines are dropped. Rows with equal
+// keys keep their input order. A file already in date order is left untouched and false is
+// returned. Rows are sorted in memory while they fit in `memory_budget` bytes; larger files
+// are cut into sorted runs of that size next to the file and k-way merged.
+bool sort_by_date(const std::string& filename, date_order order, size_t memory_budget = DATE_SORT_MEMORY) {
+	FE_PROFILE_SCOPE("date_sort");
+	if (in_date_order(filename, order)) return false;
+
+	struct keyed_row {
+		date_key key;
+		std::string line;
+	};
+	auto before = [order](const keyed_row& a, const keyed_row& b) { return date_key_before(a.key, b.key, order); };
+	auto write_rows = [](std::ofstream& out, const std::vector<keyed_row>& rows) {
+		for (const auto& row : rows) {
+			out << row.line << '\n';
+		}
+	};
+
+	const std::string sorted_file = filename + ".sorted";
+	std::vector<std::string> runs;
+	try {
+		std::ifstream file{ filename, std::ios::binary };
+		std::string header, line;
+		std::getline(file, header);
+
+		std::vector<keyed_row> rows;
+		size_t bytes = 0;
+		bool spill = false;
+		for (bool more = true; more;) {
+			more = static_cast<bool>(std::getline(file, line));
+			if (more && !line.empty()) {
+				bytes += line.size() + sizeof(keyed_row);
+				date_key key = row_date_key(line, filename);
+				rows.push_back({ std::move(key), std::move(line) });
+			}
+			if (bytes < memory_budget && more) continue;
+			if (more) spill = true;
+			std::stable_sort(rows.begin(), rows.end(), before);
+			if (!spill) break;
+			runs.push_back(filename + ".run" + std::to_string(runs.size()));
+			std::ofstream run{ runs.back(), std::ios::binary };
+			write_rows(run, rows);
+			if (!run) throw std::runtime_error("Date sort: could not write " + runs.back());
+			rows.clear();
+			bytes = 0;
+		}
+
+		std::ofstream out{ sorted_file, std::ios::binary };
+		out << header << '\n';
+		if (runs.empty()) {
+			write_rows(out, rows);
+		}
+		else {
+			// Heads of every run in a min-heap; equal keys come from the earlier run first,
+			// which keeps the sort stable across runs.
+			struct run_cursor {
+				std::ifstream in;
+				keyed_row head;
+			};
+			std::vector<run_cursor> cursors(runs.size());
+			auto advance = [&](size_t r) {
+				std::string next;
+				if (!std::getline(cursors[r].in, next)) return false;
+				cursors[r].head.key = row_date_key(next, runs[r]);
+				cursors[r].head.line = std::move(next);
+				return true;
+			};
+			auto later = [&](size_t a, size_t b) {
+				if (before(cursors[b].head, cursors[a].head)) return true;
+				if (before(cursors[a].head, cursors[b].head)) return false;
+				return a > b;
+			};
+			std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heads(later);
+			for (size_t r = 0; r < runs.size(); ++r) {
+				cursors[r].in.open(runs[r], std::ios::binary);
+				if (advance(r)) heads.push(r);
+			}
+			while (!heads.empty()) {
+				size_t r = heads.top();
+				heads.pop();
+				out << cursors[r].head.line << '\n';
+				if (advance(r)) heads.push(r);
+			}
+		}
+		out.close();
+		if (!out) throw std::runtime_error("Date sort: could not write " + sorted_file);
+		file.close();
+		std::filesystem::rename(sorted_file, filename);
+	}
+	catch (...) {
+		std::error_code ignored;
+		std::filesystem::remove(sorted_file, ignored);
+		for (const auto& run : runs) {
+			std::filesystem::remove(run, ignored);
+		}
+		throw;
+	}
+	for (const auto& run : runs) {
+		std::filesystem::remove(run);
+	}
+	return true;
+}
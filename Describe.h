@@ -0,0 +1,346 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+#include "DataFrame.h"
+#include "Parallel.h"
+
+// Items a quantile_sketch keeps on its top level; rank error shrinks roughly as 1/k.
+constexpr size_t QUANTILE_SKETCH_K = 256;
+
+// Quantiles every column profile reports.
+constexpr double DESCRIBE_QUANTILES[] = { 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99 };
+
+// KLL-style mergeable quantile sketch. Level h holds items that each stand for 2^h inputs;
+// a full level is sorted and every other item is promoted to the level above. Capacities
+// shrink by 2/3 per level below the top, so the sketch stays O(k) items. Up to k inputs it
+// is exact. The promoted half is picked by a hashed compaction count rather than a random
+// device, which keeps reports reproducible run to run.
+class quantile_sketch {
+public:
+	void add(double value) {
+		if (levels.empty()) levels.emplace_back();
+		levels[0].push_back(value);
+		++inputs;
+		if (levels[0].size() >= capacity(0)) compress();
+	}
+
+	void merge(const quantile_sketch& other) {
+		if (other.inputs == 0) return;
+		if (levels.size() < other.levels.size()) levels.resize(other.levels.size());
+		for (size_t h = 0; h < other.levels.size(); ++h) {
+			levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+		}
+		inputs += other.inputs;
+		compress();
+	}
+
+	size_t count() const {
+		return inputs;
+	}
+
+	// Nearest-rank estimate of the q-quantile; NaN when empty.
+	double quantile(double q) const {
+		std::vector<std::pair<double, std::uint64_t>> weighted;
+		std::uint64_t total = 0;
+		for (size_t h = 0; h < levels.size(); ++h) {
+			for (double value : levels[h]) {
+				weighted.emplace_back(value, std::uint64_t{ 1 } << h);
+				total += std::uint64_t{ 1 } << h;
+			}
+		}
+		if (total == 0) return std::numeric_limits<double>::quiet_NaN();
+		std::sort(weighted.begin(), weighted.end());
+		const double target = std::max(1.0, std::ceil(q * double(total)));
+		std::uint64_t seen = 0;
+		for (const auto& [value, weight] : weighted) {
+			seen += weight;
+			if (double(seen) >= target) return value;
+		}
+		return weighted.back().first;
+	}
+
+private:
+	std::vector<std::vector<double>> levels;
+	size_t inputs = 0;
+	std::uint64_t compactions = 0;
+
+	size_t capacity(size_t level) const {
+		const size_t depth = levels.size() - 1 - level;
+		return std::max<size_t>(2, static_cast<size_t>(std::ceil(QUANTILE_SKETCH_K * std::pow(2.0 / 3.0, double(depth)))));
+	}
+
+	// SplitMix64 of the compaction count: a fair bit per compaction, the same every run.
+	size_t coin() {
+		std::uint64_t z = (++compactions) * 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return static_cast<size_t>((z ^ (z >> 31)) & 1);
+	}
+
+	void compress() {
+		for (size_t h = 0; h < levels.size(); ++h) {
+			if (levels[h].size() < capacity(h)) continue;
+			if (h + 1 == levels.size()) levels.emplace_back();
+			std::vector<double>& level = levels[h];
+			std::sort(level.begin(), level.end());
+			// An odd item out stays behind so the promoted half keeps the level's weight exact.
+			const size_t paired = level.size() & ~size_t{ 1 };
+			for (size_t i = coin(); i < paired; i += 2) {
+				levels[h + 1].push_back(level[i]);
+			}
+			const bool odd = level.size() != paired;
+			const double leftover = level.back();
+			level.clear();
+			if (odd) level.push_back(leftover);
+		}
+	}
+};
+
+// One column's single-pass summary. Cells are null when empty, non_numeric when they don't
+// parse; NaN and +-inf are counted apart and left out of min/max/mean/std and the quantiles.
+// Profiles merge exactly (the sketch approximately), so per-thread partials can be combined.
+struct column_profile {
+	size_t count = 0;        // cells seen
+	size_t nulls = 0;
+	size_t non_numeric = 0;
+	size_t nans = 0;
+	size_t pos_infs = 0;
+	size_t neg_infs = 0;
+	size_t finite = 0;
+	double min = std::numeric_limits<double>::infinity();
+	double max = -std::numeric_limits<double>::infinity();
+	double mean = 0.0;
+	double m2 = 0.0;         // sum of squared deviations from the mean
+	quantile_sketch sketch;
+
+	void add(const std::string& cell) {
+		++count;
+		double value;
+		if (!parse_double(cell, value)) {
+			if (cell.find_first_not_of(" \t\r") == std::string::npos) ++nulls;
+			else ++non_numeric;
+			return;
+		}
+		if (std::isnan(value)) { ++nans; return; }
+		if (std::isinf(value)) { ++(value > 0 ? pos_infs : neg_infs); return; }
+		++finite;
+		min = std::min(min, value);
+		max = std::max(max, value);
+		const double delta = value - mean;
+		mean += delta / double(finite);
+		m2 += delta * (value - mean);
+		sketch.add(value);
+	}
+
+	// Chan et al.'s pairwise update for mean and m2.
+	void merge(const column_profile& other) {
+		count += other.count;
+		nulls += other.nulls;
+		non_numeric += other.non_numeric;
+		nans += other.nans;
+		pos_infs += other.pos_infs;
+		neg_infs += other.neg_infs;
+		if (other.finite == 0) return;
+		const double n = double(finite + other.finite);
+		const double delta = other.mean - mean;
+		mean += delta * double(other.finite) / n;
+		m2 += other.m2 + delta * delta * double(finite) * double(other.finite) / n;
+		finite += other.finite;
+		min = std::min(min, other.min);
+		max = std::max(max, other.max);
+		sketch.merge(other.sketch);
+	}
+
+	// Sample standard deviation; NaN below two finite values.
+	double stddev() const {
+		return finite > 1 ? std::sqrt(m2 / double(finite - 1)) : std::numeric_limits<double>::quiet_NaN();
+	}
+
+	bool constant() const {
+		return finite > 0 && min == max;
+	}
+};
+
+// Profiles of `names` over all rows and per group (e.g. per SEASON, in first-seen order).
+struct describe_report {
+	std::vector<std::string> names;
+	size_t rows = 0;
+	std::string group_column;
+	std::vector<column_profile> overall;                   // one per name
+	std::vector<std::string> groups;
+	std::vector<std::vector<column_profile>> group_profiles; // [group][name]
+};
+
+// Profiles every column in `columns` in one pass over the rows. The rows are split into one
+// contiguous chunk per worker; each worker fills its own [group][column] profiles, which are
+// then merged in worker order, and the overall profile is the merge of the groups. Without a
+// `group_column` every row is in a single group.
+describe_report describe(dataframe& data, const std::vector<std::string>& columns, const std::string& group_column = "") {
+	FE_PROFILE_SCOPE("describe");
+	describe_report report;
+	report.group_column = group_column;
+
+	std::vector<const string_vector*> sources;
+	for (const auto& name : columns) {
+		if (!data.count(name) || std::find(report.names.begin(), report.names.end(), name) != report.names.end()) continue;
+		const string_vector& column = data[name];
+		if (!sources.empty() && column.size() != sources[0]->size()) {
+			throw std::runtime_error("Column '" + name + "' has a different size than the first column. All columns must be the same length.");
+		}
+		report.names.push_back(name);
+		sources.push_back(&column);
+	}
+	const size_t p = sources.size();
+	const size_t n = p ? sources[0]->size() : 0;
+	report.rows = n;
+
+	std::vector<std::uint32_t> group_of(n, 0);
+	if (!group_column.empty()) {
+		auto it = data.find(group_column);
+		if (it == data.end()) throw std::runtime_error("describe: no column named '" + group_column + "'");
+		const string_vector& keys = it->second;
+		if (keys.size() != n) throw std::runtime_error("describe: column '" + group_column + "' has a different length than the profiled columns.");
+		category_dictionary groups;
+		for (size_t i = 0; i < n; ++i) {
+			group_of[i] = groups.encode(keys[i]);
+		}
+		for (std::uint32_t g = 0; g < groups.size(); ++g) {
+			report.groups.push_back(groups[g]);
+		}
+	}
+	else {
+		report.groups.push_back("");
+	}
+	const size_t group_count = report.groups.size();
+
+	const size_t workers = std::max<size_t>(1, std::min(parallel_width(), n));
+	std::vector<std::vector<column_profile>> partial(workers);
+	parallel_chunks(n, workers, [&](size_t worker, size_t begin, size_t end) {
+		std::vector<column_profile>& profiles = partial[worker];
+		profiles.resize(group_count * p);
+		for (size_t j = 0; j < p; ++j) {
+			const string_vector& column = *sources[j];
+			for (size_t i = begin; i < end; ++i) {
+				profiles[group_of[i] * p + j].add(column[i]);
+			}
+		}
+	});
+
+	report.group_profiles.assign(group_count, std::vector<column_profile>(p));
+	for (const auto& profiles : partial) {
+		if (profiles.empty()) continue;
+		for (size_t g = 0; g < group_count; ++g) {
+			for (size_t j = 0; j < p; ++j) {
+				report.group_profiles[g][j].merge(profiles[g * p + j]);
+			}
+		}
+	}
+	report.overall.resize(p);
+	for (const auto& profiles : report.group_profiles) {
+		for (size_t j = 0; j < p; ++j) {
+			report.overall[j].merge(profiles[j]);
+		}
+	}
+	if (group_column.empty()) {
+		report.groups.clear();
+		report.group_profiles.clear();
+	}
+	return report;
+}
+
+// JSON string literal with quotes and backslashes escaped.
+std::string json_string(const std::string& text) {
+	std::string quoted = "\"";
+	for (char c : text) {
+		if (c == '"' || c == '\\') quoted += '\\';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+// Writes "<stem>_describe.json": the overall profile of every column, the same per group,
+// and the columns that need a look (NaN/inf cells, no numbers at all, or a constant value).
+// Statistics with no finite input are written as null.
+void save_describe_report(const describe_report& report, const std::string& stem) {
+	const std::string filename = stem + "_describe.json";
+	std::ofstream file(filename);
+	if (!file.is_open()) {
+		throw std::runtime_error("Could not open file for writing: " + filename);
+	}
+	file.precision(10);
+	auto number = [&file](double value) {
+		if (std::isfinite(value)) file << value;
+		else file << "null";
+	};
+	auto write_profiles = [&](const std::vector<column_profile>& profiles, const char* indent) {
+		file << "{";
+		for (size_t j = 0; j < profiles.size(); ++j) {
+			const column_profile& c = profiles[j];
+			const bool any = c.finite > 0;
+			file << (j ? "," : "") << "\n" << indent << "  " << json_string(report.names[j]) << ": {"
+				<< "\"count\": " << c.count << ", \"nulls\": " << c.nulls << ", \"non_numeric\": " << c.non_numeric
+				<< ", \"nan\": " << c.nans << ", \"pos_inf\": " << c.pos_infs << ", \"neg_inf\": " << c.neg_infs
+				<< ", \"finite\": " << c.finite << ", \"min\": ";
+			number(any ? c.min : std::numeric_limits<double>::quiet_NaN());
+			file << ", \"max\": ";
+			number(any ? c.max : std::numeric_limits<double>::quiet_NaN());
+			file << ", \"mean\": ";
+			number(any ? c.mean : std::numeric_limits<double>::quiet_NaN());
+			file << ", \"std\": ";
+			number(c.stddev());
+			file << ", \"quantiles\": {";
+			for (size_t q = 0; q < std::size(DESCRIBE_QUANTILES); ++q) {
+				file << (q ? ", " : "") << "\"" << DESCRIBE_QUANTILES[q] << "\": ";
+				number(c.sketch.quantile(DESCRIBE_QUANTILES[q]));
+			}
+			file << "}, \"constant\": " << (c.constant() ? "true" : "false") << "}";
+		}
+		file << "\n" << indent << "}";
+	};
+
+	std::vector<std::string> non_finite, not_numeric, constant;
+	for (size_t j = 0; j < report.names.size(); ++j) {
+		const column_profile& c = report.overall[j];
+		if (c.nans + c.pos_infs + c.neg_infs > 0) non_finite.push_back(report.names[j]);
+		if (c.finite == 0) not_numeric.push_back(report.names[j]);
+		if (c.constant()) constant.push_back(report.names[j]);
+	}
+	auto write_names = [&file](const std::vector<std::string>& names) {
+		file << "[";
+		for (size_t i = 0; i < names.size(); ++i) {
+			file << (i ? ", " : "") << json_string(names[i]);
+		}
+		file << "]";
+	};
+
+	file << "{\n  \"rows\": " << report.rows << ",\n  \"columns\": " << report.names.size() << ",\n  \"issues\": {\"non_finite\": ";
+	write_names(non_finite);
+	file << ", \"no_numbers\": ";
+	write_names(not_numeric);
+	file << ", \"constant\": ";
+	write_names(constant);
+	file << "},\n  \"overall\": ";
+	write_profiles(report.overall, "  ");
+	if (!report.group_column.empty()) {
+		file << ",\n  \"group_by\": " << json_string(report.group_column) << ",\n  \"groups\": {";
+		for (size_t g = 0; g < report.groups.size(); ++g) {
+			file << (g ? "," : "") << "\n    " << json_string(report.groups[g]) << ": ";
+			write_profiles(report.group_profiles[g], "    ");
+		}
+		file << "\n  }";
+	}
+	file << "\n}\n";
+	if (!file) {
+		throw std::runtime_error("Could not write " + filename);
+	}
+	std::cout << "Profile of " << report.names.size() << " columns over " << report.rows << " rows saved to " << filename
+		<< " (" << non_finite.size() << " with NaN/inf, " << constant.size() << " constant)" << std::endl;
+}
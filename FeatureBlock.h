@@ -0,0 +1,182 @@
+#pragma once
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "DataFrame.h"
+#include "Parallel.h"
+
+// Read access to the slots of one row while a feature_block evaluates it.
+struct feature_row {
+	const double* const* columns;
+	size_t row;
+
+	double operator[](int slot) const {
+		return columns[slot][row];
+	}
+};
+
+// Null-aware helpers for feature expressions. Nulls are NaN inside a block: arithmetic
+// propagates them, and flags are 1/0 or NaN when an operand is null.
+double ratio(double numerator, double denominator) {
+	if (denominator == 0 && !std::isnan(numerator)) {
+		throw std::runtime_error("Division by zero in element-wise vector operation.");
+	}
+	return numerator / denominator;
+}
+
+double flag_greater(double value, double threshold) {
+	return std::isnan(value) ? value : (value > threshold ? 1.0 : 0.0);
+}
+
+double flag_less(double value, double threshold) {
+	return std::isnan(value) ? value : (value < threshold ? 1.0 : 0.0);
+}
+
+double flag_and(double lhs, double rhs) {
+	if (std::isnan(lhs) || std::isnan(rhs)) return std::numeric_limits<double>::quiet_NaN();
+	return (lhs == 1.0 && rhs == 1.0) ? 1.0 : 0.0;
+}
+
+double flag_or(double lhs, double rhs) {
+	if (std::isnan(lhs) || std::isnan(rhs)) return std::numeric_limits<double>::quiet_NaN();
+	return (lhs == 1.0 || rhs == 1.0) ? 1.0 : 0.0;
+}
+
+// A set of row-wise derived columns evaluated together. Input columns and definitions each
+// get a slot; a definition reads earlier slots of the same row. evaluate() splits the rows
+// into morsels small enough for a morsel's slots to stay in cache and runs them on
+// parallel_morsels: each worker parses its morsel's inputs, evaluates every definition over
+// it and formats the results straight into the output columns. Intermediate values stay
+// doubles, so they are not rounded to their text form between definitions.
+class feature_block {
+public:
+	using expression = std::function<double(const feature_row&)>;
+
+	static constexpr size_t MORSEL_BYTES = 256 * 1024;
+
+	// Slot of an input column (declaring it once).
+	int input(const std::string& column) {
+		for (size_t i = 0; i < input_slots.size(); ++i) {
+			if (slot_names[input_slots[i]] == column) return input_slots[i];
+		}
+		int slot = add_slot(column);
+		input_slots.push_back(slot);
+		return slot;
+	}
+
+	int define(const std::string& name, expression fn) {
+		int slot = add_slot(name);
+		definitions.push_back({ slot, std::move(fn) });
+		return slot;
+	}
+
+	size_t slot_count() const {
+		return slot_names.size();
+	}
+
+	const std::string& slot_name(int slot) const {
+		return slot_names[slot];
+	}
+
+	// Slot of a column or definition, or -1.
+	int slot(const std::string& name) const {
+		for (size_t i = 0; i < slot_names.size(); ++i) {
+			if (slot_names[i] == name) return static_cast<int>(i);
+		}
+		return -1;
+	}
+
+	const std::vector<int>& inputs() const {
+		return input_slots;
+	}
+
+	// Evaluates one row in place: `slots` holds slot_count() values with the inputs filled in.
+	void evaluate_row(double* slots) const {
+		std::vector<const double*> columns(slot_names.size());
+		for (size_t i = 0; i < columns.size(); ++i) {
+			columns[i] = &slots[i];
+		}
+		feature_row row{ columns.data(), 0 };
+		for (const auto& definition : definitions) {
+			slots[definition.slot] = definition.fn(row);
+		}
+	}
+
+	// Adds (or replaces) one column per definition in `data`.
+	void evaluate(dataframe& data) const {
+		FE_PROFILE_SCOPE("feature_block");
+		std::vector<const string_vector*> sources(input_slots.size());
+		for (size_t i = 0; i < input_slots.size(); ++i) {
+			auto it = data.find(slot_names[input_slots[i]]);
+			if (it == data.end()) {
+				throw std::runtime_error("Feature block: no column named '" + slot_names[input_slots[i]] + "'");
+			}
+			sources[i] = &it->second;
+		}
+		const size_t rows = sources.empty() ? 0 : sources[0]->size();
+		for (const auto* source : sources) {
+			if (source->size() != rows) {
+				throw std::runtime_error("Feature block: input columns must be the same length.");
+			}
+		}
+
+		std::vector<std::vector<double>> values(slot_names.size(), std::vector<double>(rows));
+		std::vector<const double*> columns(slot_names.size());
+		for (size_t i = 0; i < values.size(); ++i) {
+			columns[i] = values[i].data();
+		}
+		std::vector<string_vector*> outputs(definitions.size());
+		for (size_t d = 0; d < definitions.size(); ++d) {
+			string_vector& output = data[slot_names[definitions[d].slot]];
+			output = string_vector(rows);
+			outputs[d] = &output;
+		}
+
+		const size_t morsel = std::max<size_t>(64, MORSEL_BYTES / (sizeof(double) * std::max<size_t>(1, slot_names.size())));
+		parallel_morsels(rows, morsel, [&](size_t, size_t begin, size_t end) {
+			for (size_t i = 0; i < input_slots.size(); ++i) {
+				double* column = values[input_slots[i]].data();
+				for (size_t r = begin; r < end; ++r) {
+					parse_double((*sources[i])[r], column[r]);
+				}
+			}
+			for (const auto& definition : definitions) {
+				double* column = values[definition.slot].data();
+				for (size_t r = begin; r < end; ++r) {
+					column[r] = definition.fn(feature_row{ columns.data(), r });
+				}
+			}
+			char buffer[32];
+			for (size_t d = 0; d < definitions.size(); ++d) {
+				const double* column = values[definitions[d].slot].data();
+				string_vector& output = *outputs[d];
+				for (size_t r = begin; r < end; ++r) {
+					if (std::isnan(column[r])) continue;
+					int length = std::snprintf(buffer, sizeof(buffer), "%g", column[r]);
+					output[r].assign(buffer, static_cast<size_t>(length));
+				}
+			}
+		});
+	}
+
+private:
+	struct definition {
+		int slot;
+		expression fn;
+	};
+	std::vector<std::string> slot_names;
+	std::vector<int> input_slots;
+	std::vector<definition> definitions;
+
+	int add_slot(const std::string& name) {
+		if (slot(name) >= 0) {
+			throw std::runtime_error("Feature block: '" + name + "' is declared twice.");
+		}
+		slot_names.push_back(name);
+		return static_cast<int>(slot_names.size() - 1);
+	}
+};
@@ -0,0 +1,485 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include "Date.h"
+#include "Ratings.h"
+#include "FeatureBlock.h"
+#include "LaggedAverages.h"
+
+// Last game per team, giving rest days by the rest-days stage's rule: 50 for a team's first
+// game of a season (the stage runs per season file), otherwise the days since its last game.
+class rest_day_tracker {
+public:
+    int rest_days(std::string_view team, std::string_view date) const {
+        const std::uint32_t id = teams.find(team);
+        if (id == category_dictionary::npos || last_season[id] != season_of(date)) return 50;
+        long long match_day = day_number(date);
+        if (match_day < 0 || last_day[id] < 0) return 0;
+        return match_day > last_day[id] ? static_cast<int>(match_day - last_day[id]) : 0;
+    }
+
+    void record(std::string_view team, std::string_view date) {
+        const std::uint32_t id = teams.encode(team);
+        if (id == last_day.size()) {
+            last_day.emplace_back();
+            last_season.emplace_back();
+        }
+        last_day[id] = day_number(date);
+        last_season[id] = season_of(date);
+    }
+
+private:
+    category_dictionary teams;
+    std::vector<long long> last_day;
+    std::vector<std::string> last_season;
+};
+
+// Running EWM and last `window` game totals of one team on one side (home or away).
+struct total_history {
+    bool seeded = false;
+    double smoothed = 0.0;
+    std::deque<double> recent; // NaN for games without a total
+    size_t games = 0;
+};
+
+// In-memory copy of the batch pipeline's per-team state, answering "what would the feature
+// row of this game be" without rebuilding anything. It is fed the same combined season rows
+// the lag stage reads (load) or single completed games (ingest), keeps the lag windows,
+// last-match dates and team-total histories, and evaluates the derived feature block for one
+// row on request. Lagged values are rounded the way the lagged file stores them, so a served
+// row matches the row data_file.csv gets for that game once the batch is rerun. With ratings
+// on, its own rating engine follows the same games and answers the rating columns.
+template <typename Schema>
+class basic_feature_store {
+public:
+    basic_feature_store(feature_block derived, std::vector<std::string> columns, int window_size, double total_ewm_alpha, size_t total_std_window,
+        bool robust_lags = false, const rating_options& rating = {})
+        : derived(std::move(derived)), output_columns(std::move(columns)), lags(window_size, robust_lags), robust_lags(robust_lags),
+          total_ewm_alpha(total_ewm_alpha), total_std_window(total_std_window) {
+        if (rating.enabled) {
+            rating_options emitted_only = rating;
+            emitted_only.sweep_k.clear();
+            emitted_only.sweep_home_advantage.clear();
+            ratings.emplace(emitted_only);
+        }
+        for (std::string_view stat : Schema::stats) {
+            lagged_names.push_back("H_" + std::string(stat));
+            lagged_names.push_back("A_" + std::string(stat));
+        }
+        for (const char* name : TAIL_COLUMNS) {
+            lagged_names.push_back(name);
+        }
+        for (std::string_view stat : Schema::allowed) {
+            lagged_names.push_back("H_" + std::string(stat) + "_ALLOWED");
+            lagged_names.push_back("A_" + std::string(stat) + "_ALLOWED");
+        }
+        for (const char* name : SPREAD_COLUMNS) {
+            lagged_names.push_back(name);
+        }
+        for (const char* name : H2H_COLUMNS) {
+            lagged_names.push_back(name);
+        }
+        if (robust_lags) {
+            for (auto& name : robust_lag_columns<Schema>()) {
+                lagged_names.push_back(std::move(name));
+            }
+        }
+
+        for (int slot : this->derived.inputs()) {
+            int index = lagged_index(this->derived.slot_name(slot));
+            if (index < 0) {
+                throw std::runtime_error("Feature store: derived input '" + this->derived.slot_name(slot) + "' is not a lagged column");
+            }
+            input_sources.push_back({ slot, index });
+        }
+        for (const auto& name : output_columns) {
+            column_source source{ source_kind::missing, 0 };
+            if (name == "DATE" || name == "HOME" || name == "AWAY") source = { source_kind::key, 0 };
+            else if (int slot = this->derived.slot(name); slot >= 0) source = { source_kind::derived, slot };
+            else if (int window = total_index(name); window >= 0) source = { source_kind::total, window };
+            else if (int rating_column = rating_index(name); rating_column >= 0) source = { source_kind::rating, rating_column };
+            else if (int index = lagged_index(name); index >= 0) source = { source_kind::lagged, index };
+            sources.push_back(source);
+        }
+    }
+
+    const std::vector<std::string>& columns() const {
+        return output_columns;
+    }
+
+    // Replays a combined season file (the lag stage's input), oldest game first.
+    void load(const std::string& filename) {
+        std::ifstream file{ filename };
+        if (!file.is_open()) {
+            throw std::runtime_error("Feature store: could not open " + filename);
+        }
+        std::string line;
+        std::getline(file, line);
+        check_lag_header<Schema>(line, filename);
+        while (std::getline(file, line)) {
+            if (line.empty()) continue;
+            lag_row<Schema> row = parse_lag_row<Schema>(line);
+            record(row);
+        }
+    }
+
+    // Records one completed game given as DATE,HOME,AWAY, the schema's stat pairs and TOTAL,
+    // with a full "dd.mm.yyyy." date. Rest days are derived from the games seen so far.
+    void ingest(const std::string& line) {
+        field_cursor fields{ line };
+        std::string_view date = fields.next();
+        std::string_view home = fields.next();
+        std::string_view away = fields.next();
+        if (day_number(date) < 0) {
+            throw std::runtime_error("Feature store: invalid date '" + std::string(date) + "'");
+        }
+        std::string full = line + "," + std::to_string(rests.rest_days(home, date)) + "," + std::to_string(rests.rest_days(away, date));
+        lag_row<Schema> row = parse_lag_row<Schema>(full);
+        if (std::count(row.tail.begin(), row.tail.end(), ',') != 2) {
+            throw std::runtime_error("Feature store: a game is DATE,HOME,AWAY, the stat pairs and TOTAL");
+        }
+        record(row);
+    }
+
+    // The feature vector of an upcoming game, aligned with columns(). Key and unknown columns
+    // (TOTAL) are NaN, as are null features. False while either team lacks a full lag window.
+    bool features(const std::string& date, const std::string& home, const std::string& away, std::vector<double>& values) const {
+        using traits = schema_traits<Schema>;
+        lag_output<Schema> out;
+        if (!lags.preview(home, away, out)) return false;
+
+        const double null = std::numeric_limits<double>::quiet_NaN();
+        std::vector<double> lagged(lagged_names.size(), null);
+        for (int i = 0; i < traits::pairs; ++i) {
+            lagged[2 * i] = as_stored(out.home.averages[i]);
+            lagged[2 * i + 1] = as_stored(out.away.averages[i]);
+        }
+        const size_t tail = 2 * traits::pairs;
+        lagged[tail + 1] = rests.rest_days(home, date);
+        lagged[tail + 2] = rests.rest_days(away, date);
+        const size_t allowed = tail + std::size(TAIL_COLUMNS);
+        for (int k = 0; k < traits::allowed; ++k) {
+            lagged[allowed + 2 * k] = as_stored(out.home.averages[traits::pairs + k]);
+            lagged[allowed + 2 * k + 1] = as_stored(out.away.averages[traits::pairs + k]);
+        }
+        const size_t spread = allowed + 2 * traits::allowed;
+        const std::array<double, std::size(SPREAD_COLUMNS)> spreads = {
+            out.home.stddev, out.away.stddev, out.home.entropy, out.away.entropy,
+            out.home.conditional_entropy, out.away.conditional_entropy,
+        };
+        for (size_t i = 0; i < spreads.size(); ++i) {
+            lagged[spread + i] = as_stored(spreads[i]);
+        }
+        const size_t h2h = spread + spreads.size();
+        lagged[h2h] = out.h2h.meetings;
+        lagged[h2h + 1] = as_stored(out.h2h.total);
+        lagged[h2h + 2] = as_stored(out.h2h.margin);
+        lagged[h2h + 3] = as_stored(out.h2h.pace);
+        if (robust_lags) {
+            size_t column = h2h + std::size(H2H_COLUMNS);
+            for (double robust_summary::*statistic : { &robust_summary::median, &robust_summary::iqr, &robust_summary::trimmed_mean }) {
+                for (int i = 0; i < traits::tracks; ++i) {
+                    lagged[column++] = as_stored(out.home.robust[i].*statistic);
+                    lagged[column++] = as_stored(out.away.robust[i].*statistic);
+                }
+            }
+        }
+
+        std::vector<double> slots(derived.slot_count(), null);
+        for (const auto& input : input_sources) {
+            slots[input.slot] = lagged[input.lagged];
+        }
+        derived.evaluate_row(slots.data());
+
+        const std::array<double, 4> totals = {
+            total_ewm(home, side::home), total_ewm(away, side::away),
+            total_std(home, side::home), total_std(away, side::away),
+        };
+        game_ratings pre_game{};
+        if (ratings) {
+            pre_game = ratings->preview(date, home, away);
+            for (double& value : pre_game.values) value = as_stored(value);
+        }
+
+        values.assign(output_columns.size(), null);
+        for (size_t c = 0; c < sources.size(); ++c) {
+            switch (sources[c].kind) {
+            case source_kind::lagged: values[c] = lagged[sources[c].index]; break;
+            case source_kind::derived: values[c] = slots[sources[c].index]; break;
+            case source_kind::total: values[c] = totals[sources[c].index]; break;
+            case source_kind::rating: values[c] = pre_game.values[sources[c].index]; break;
+            default: break;
+            }
+        }
+        return true;
+    }
+
+    // The game's row as data_file.csv would hold it (TOTAL left empty).
+    bool feature_line(const std::string& date, const std::string& home, const std::string& away, std::string& line) const {
+        std::vector<double> values;
+        if (!features(date, home, away, values)) return false;
+        line.clear();
+        char buffer[32];
+        for (size_t c = 0; c < output_columns.size(); ++c) {
+            if (c > 0) line += ',';
+            const std::string& name = output_columns[c];
+            if (sources[c].kind == source_kind::key) {
+                line += (name == "DATE") ? date : (name == "HOME") ? home : away;
+            }
+            else if (!std::isnan(values[c])) {
+                line.append(buffer, static_cast<size_t>(std::snprintf(buffer, sizeof(buffer), "%g", values[c])));
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr const char* TAIL_COLUMNS[] = { "TOTAL", "H_REST_DAYS", "A_REST_DAYS" };
+    static constexpr const char* SPREAD_COLUMNS[] = { "H_STDDEV", "A_STDDEV", "H_ENTROPY", "A_ENTROPY", "H_COND_ENTROPY", "A_COND_ENTROPY" };
+    static constexpr const char* H2H_COLUMNS[] = { "H2H_MEETINGS", "H2H_TOTAL", "H2H_MARGIN", "H2H_PACE" };
+    static constexpr const char* TOTAL_COLUMNS[] = { "H_TOTAL_EWM", "A_TOTAL_EWM", "H_TOTAL_STD", "A_TOTAL_STD" };
+
+    enum class source_kind { missing, key, lagged, derived, total, rating };
+    struct column_source {
+        source_kind kind;
+        int index;
+    };
+    struct input_source {
+        int slot;
+        int lagged;
+    };
+
+    feature_block derived;
+    std::vector<std::string> output_columns;
+    std::vector<column_source> sources;
+    std::vector<std::string> lagged_names;
+    std::vector<input_source> input_sources;
+    lag_state<Schema> lags;
+    bool robust_lags;
+    rest_day_tracker rests;
+    std::optional<rating_engine> ratings;
+    double total_ewm_alpha;
+    size_t total_std_window;
+    category_dictionary total_teams;
+    std::vector<std::array<total_history, 2>> totals; // [team][side]
+
+    int lagged_index(const std::string& name) const {
+        for (size_t i = 0; i < lagged_names.size(); ++i) {
+            if (lagged_names[i] == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    int rating_index(const std::string& name) const {
+        if (!ratings) return -1;
+        const auto& columns = rating_columns();
+        auto it = std::find(columns.begin(), columns.end(), name);
+        return it == columns.end() ? -1 : static_cast<int>(it - columns.begin());
+    }
+
+    static int total_index(const std::string& name) {
+        for (int i = 0; i < 4; ++i) {
+            if (name == TOTAL_COLUMNS[i]) return i;
+        }
+        return -1;
+    }
+
+    // The value after a round trip through the lagged file's text.
+    static double as_stored(double value) {
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), "%g", value);
+        double stored;
+        return parse_double(std::string_view(buffer, static_cast<size_t>(length)), stored) ? stored : value;
+    }
+
+    void record(lag_row<Schema>& row) {
+        std::string home = row.home, away = row.away;
+        rests.record(home, row.date);
+        rests.record(away, row.date);
+        if (ratings) {
+            constexpr int score = stat_index<Schema>("SCORE");
+            static_assert(score >= 0, "ratings need SCORE in the schema");
+            ratings->update(row.date, home, away, row.home_values[score], row.away_values[score]);
+        }
+        double total;
+        if (!parse_double(field_cursor{ row.tail }.next(), total)) total = std::numeric_limits<double>::quiet_NaN();
+
+        // Team totals only advance on games the lag stage emits: the window features run
+        // over the rows of the feature file.
+        lag_output<Schema> out;
+        if (!lags.update(row, out)) return;
+        add_total(home, side::home, total);
+        add_total(away, side::away, total);
+    }
+
+    void add_total(const std::string& team, side s, double total) {
+        const std::uint32_t id = total_teams.encode(team);
+        if (id == totals.size()) totals.emplace_back();
+        total_history& history = totals[id][static_cast<int>(s)];
+        if (!std::isnan(total)) {
+            history.smoothed = history.seeded ? total_ewm_alpha * total + (1 - total_ewm_alpha) * history.smoothed : total;
+            history.seeded = true;
+        }
+        history.recent.push_back(total);
+        if (history.recent.size() > total_std_window) history.recent.pop_front();
+        ++history.games;
+    }
+
+    const total_history* find_total(const std::string& team, side s) const {
+        const std::uint32_t id = total_teams.find(team);
+        return id == category_dictionary::npos ? nullptr : &totals[id][static_cast<int>(s)];
+    }
+
+    double total_ewm(const std::string& team, side s) const {
+        const total_history* history = find_total(team, s);
+        return (history && history->seeded) ? history->smoothed : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // Same formula as rolling_std: sample deviation of the non-null totals among the last
+    // `window` games, null until the team has played `window` games.
+    double total_std(const std::string& team, side s) const {
+        const total_history* history = find_total(team, s);
+        if (!history || history->games < total_std_window) return std::numeric_limits<double>::quiet_NaN();
+        double sum = 0.0, sum_sq = 0.0;
+        size_t count = 0;
+        for (double total : history->recent) {
+            if (std::isnan(total)) continue;
+            sum += total;
+            sum_sq += total * total;
+            ++count;
+        }
+        if (count < 2) return std::numeric_limits<double>::quiet_NaN();
+        return std::sqrt(std::max(0.0, (sum_sq - sum * sum / double(count)) / double(count - 1)));
+    }
+};
+
+using feature_store = basic_feature_store<nba_schema>;
+
+// One request of the serving protocol, one line each way:
+//   HEADER                          -> the column names of a feature row
+//   FEATURES dd.mm.yyyy.,HOME,AWAY  -> the game's feature row (TOTAL empty)
+//   INGEST <game>                   -> records a completed game (see ingest()), replies OK
+// Failures reply "ERROR <reason>".
+template <typename Schema>
+std::string answer_feature_request(basic_feature_store<Schema>& store, const std::string& request) {
+    try {
+        size_t space = request.find(' ');
+        std::string command = request.substr(0, space);
+        std::string argument = (space == std::string::npos) ? std::string{} : request.substr(space + 1);
+        if (command == "HEADER") {
+            std::string header;
+            for (const auto& name : store.columns()) {
+                if (!header.empty()) header += ',';
+                header += name;
+            }
+            return header;
+        }
+        if (command == "FEATURES") {
+            field_cursor fields{ argument };
+            std::string date(fields.next()), home(fields.next()), away(fields.next());
+            std::string line;
+            if (!store.feature_line(date, home, away, line)) return "ERROR not enough history for " + home + " - " + away;
+            return line;
+        }
+        if (command == "INGEST") {
+            store.ingest(argument);
+            return "OK";
+        }
+        return "ERROR unknown request '" + command + "'";
+    }
+    catch (const std::exception& e) {
+        return std::string("ERROR ") + e.what();
+    }
+}
+
+// Serves feature requests on a Unix domain socket, one client at a time, until a client
+// sends SHUTDOWN. Not available on Windows builds.
+template <typename Schema>
+void serve_features(basic_feature_store<Schema>& store, const std::string& socket_path) {
+#ifdef _WIN32
+    (void)store;
+    throw std::runtime_error("Daemon mode needs Unix domain sockets; not supported on Windows builds (" + socket_path + ")");
+#else
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path is too long: " + socket_path);
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    ::unlink(socket_path.c_str());
+    if (::bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(server, 16) < 0) {
+        std::string error = std::strerror(errno);
+        ::close(server);
+        throw std::runtime_error("Could not listen on " + socket_path + ": " + error);
+    }
+    // A client that hangs up before its reply is written must not kill the daemon: writes
+    // to it fail with EPIPE instead of raising SIGPIPE, and the client is dropped.
+    std::signal(SIGPIPE, SIG_IGN);
+#ifdef MSG_NOSIGNAL
+    constexpr int send_flags = MSG_NOSIGNAL;
+#else
+    constexpr int send_flags = 0;
+#endif
+    std::cout << "Serving features on " << socket_path << std::endl;
+
+    bool running = true;
+    while (running) {
+        int client = ::accept(server, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        std::string pending;
+        char buffer[4096];
+        ssize_t received;
+        bool connected = true;
+        while (running && connected && (received = ::read(client, buffer, sizeof(buffer))) > 0) {
+            pending.append(buffer, static_cast<size_t>(received));
+            size_t newline;
+            while (connected && (newline = pending.find('\n')) != std::string::npos) {
+                std::string request = pending.substr(0, newline);
+                pending.erase(0, newline + 1);
+                if (!request.empty() && request.back() == '\r') request.pop_back();
+                if (request == "SHUTDOWN") {
+                    running = false;
+                    break;
+                }
+                std::string reply = answer_feature_request(store, request) + "\n";
+                for (size_t sent = 0; sent < reply.size();) {
+                    ssize_t n = ::send(client, reply.data() + sent, reply.size() - sent, send_flags);
+                    if (n < 0 && errno == EINTR) continue;
+                    if (n <= 0) {
+                        connected = false; // EPIPE / ECONNRESET: back to accept
+                        break;
+                    }
+                    sent += static_cast<size_t>(n);
+                }
+            }
+        }
+        ::close(client);
+    }
+    ::close(server);
+    ::unlink(socket_path.c_str());
+#endif
+}
@@ -0,0 +1,221 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include "DataFrame.h"
+#include "Parallel.h"
+
+enum class aggregate { sum, mean, min, max, count, stddev };
+
+struct aggregation {
+	std::string column;
+	aggregate kind;
+	std::string output{}; // defaults to "<column>_<KIND>"
+};
+
+std::string aggregate_name(aggregate kind) {
+	switch (kind) {
+	case aggregate::sum: return "SUM";
+	case aggregate::mean: return "MEAN";
+	case aggregate::min: return "MIN";
+	case aggregate::max: return "MAX";
+	case aggregate::count: return "COUNT";
+	case aggregate::stddev: return "STDDEV";
+	}
+	return "";
+}
+
+// Running totals for one (group, aggregation) cell. Nulls are skipped; the mean and
+// variance use Welford's update so long groups do not lose precision.
+struct aggregate_state {
+	size_t count = 0;
+	double sum = 0.0;
+	double mean = 0.0;
+	double m2 = 0.0;
+	double min = std::numeric_limits<double>::infinity();
+	double max = -std::numeric_limits<double>::infinity();
+
+	void add(double value) {
+		++count;
+		sum += value;
+		double delta = value - mean;
+		mean += delta / double(count);
+		m2 += delta * (value - mean);
+		min = std::min(min, value);
+		max = std::max(max, value);
+	}
+
+	// Returns false when the aggregate is undefined for this group (no values, or fewer than two for stddev).
+	bool result(aggregate kind, double& value) const {
+		switch (kind) {
+		case aggregate::count: value = double(count); return true;
+		case aggregate::sum: value = sum; return count > 0;
+		case aggregate::mean: value = mean; return count > 0;
+		case aggregate::min: value = min; return count > 0;
+		case aggregate::max: value = max; return count > 0;
+		case aggregate::stddev:
+			if (count < 2) return false;
+			value = std::sqrt(m2 / double(count - 1));
+			return true;
+		}
+		return false;
+	}
+};
+
+// Groups rows by the key columns and computes the requested aggregates per group.
+// Rows are hashed and scattered into one partition per worker in parallel; every
+// partition is then aggregated by a single thread in its own hash table, so no
+// locking or merging is needed. Groups come back sorted by key. With `selection`, only
+// those rows are grouped.
+dataframe group_by(const dataframe& data, const std::vector<std::string>& keys, const std::vector<aggregation>& aggregations,
+	const selection_vector* selection = nullptr) {
+	FE_PROFILE_SCOPE("group_by");
+
+	if (keys.empty()) {
+		throw std::runtime_error("group_by needs at least one key column.");
+	}
+	auto column = [&data](const std::string& name) -> const string_vector& {
+		auto it = data.find(name);
+		if (it == data.end()) {
+			throw std::runtime_error("group_by: no column named '" + name + "'");
+		}
+		return it->second;
+	};
+
+	std::vector<const string_vector*> key_columns;
+	for (const auto& key : keys) {
+		key_columns.push_back(&column(key));
+	}
+	const size_t rows = key_columns[0]->size();
+	for (const auto* key_column : key_columns) {
+		if (key_column->size() != rows) {
+			throw std::runtime_error("group_by: key columns must be the same length.");
+		}
+	}
+	if (selection && !selection->empty() && selection->back() >= rows) {
+		throw std::runtime_error("group_by: row selection is out of range.");
+	}
+	const size_t selected = selection ? selection->size() : rows;
+
+	std::vector<numeric_column> values(aggregations.size());
+	parallel_chunks(aggregations.size(), [&](size_t, size_t begin, size_t end) {
+		for (size_t a = begin; a < end; ++a) {
+			values[a] = column(aggregations[a].column).to_numeric();
+			if (values[a].values.size() != rows) {
+				throw std::runtime_error("group_by: column '" + aggregations[a].column + "' has a different length than the keys.");
+			}
+		}
+	});
+
+	// Categorical keys hash and compare their codes instead of the strings.
+	auto same_key = [&](size_t i, size_t j) {
+		for (const auto* key_column : key_columns) {
+			if (key_column->is_categorical()) {
+				if (key_column->codes()[i] != key_column->codes()[j]) return false;
+			}
+			else if ((*key_column)[i] != (*key_column)[j]) return false;
+		}
+		return true;
+	};
+
+	// Pass 1: hash every row and scatter its index into a per-worker, per-partition bucket.
+	const size_t workers = parallel_width();
+	const size_t partitions = workers;
+	std::vector<std::uint64_t> hashes(rows);
+	std::vector<std::vector<std::vector<std::uint32_t>>> buckets(workers, std::vector<std::vector<std::uint32_t>>(partitions));
+	parallel_chunks(selected, workers, [&](size_t worker, size_t begin, size_t end) {
+		std::hash<std::string> hasher;
+		for (size_t k = begin; k < end; ++k) {
+			const size_t i = selection ? (*selection)[k] : k;
+			std::uint64_t h = 0;
+			for (const auto* key_column : key_columns) {
+				std::uint64_t key_hash = key_column->is_categorical()
+					? key_column->codes()[i] * 0xFF51AFD7ED558CCDULL
+					: hasher((*key_column)[i]);
+				h ^= key_hash + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+			}
+			hashes[i] = h;
+			buckets[worker][h % partitions].push_back(static_cast<std::uint32_t>(i));
+		}
+	});
+
+	// Pass 2: each partition owns a disjoint set of keys and is aggregated independently.
+	struct partition_groups {
+		std::vector<std::uint32_t> first_row;
+		std::vector<aggregate_state> states; // first_row.size() * aggregations.size()
+	};
+	std::vector<partition_groups> groups(partitions);
+	parallel_chunks(partitions, workers, [&](size_t, size_t begin, size_t end) {
+		for (size_t p = begin; p < end; ++p) {
+			partition_groups& part = groups[p];
+			std::unordered_map<std::uint64_t, std::uint32_t> head;
+			std::vector<std::uint32_t> next;
+			const std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+			for (size_t w = 0; w < workers; ++w) {
+				for (std::uint32_t row : buckets[w][p]) {
+					auto [it, inserted] = head.try_emplace(hashes[row], none);
+					std::uint32_t g = it->second;
+					while (g != none && !same_key(part.first_row[g], row)) {
+						g = next[g];
+					}
+					if (g == none) {
+						g = static_cast<std::uint32_t>(part.first_row.size());
+						part.first_row.push_back(row);
+						next.push_back(it->second);
+						it->second = g;
+						part.states.resize(part.states.size() + aggregations.size());
+					}
+					aggregate_state* state = &part.states[size_t(g) * aggregations.size()];
+					for (size_t a = 0; a < aggregations.size(); ++a) {
+						if (values[a].validity.test(row)) {
+							state[a].add(values[a].values[row]);
+						}
+					}
+				}
+			}
+		}
+	});
+
+	std::vector<std::pair<size_t, size_t>> order; // (partition, group)
+	for (size_t p = 0; p < partitions; ++p) {
+		for (size_t g = 0; g < groups[p].first_row.size(); ++g) {
+			order.emplace_back(p, g);
+		}
+	}
+	std::sort(order.begin(), order.end(), [&](const auto& lhs, const auto& rhs) {
+		size_t i = groups[lhs.first].first_row[lhs.second];
+		size_t j = groups[rhs.first].first_row[rhs.second];
+		for (const auto* key_column : key_columns) {
+			int cmp = (*key_column)[i].compare((*key_column)[j]);
+			if (cmp != 0) return cmp < 0;
+		}
+		return false;
+	});
+
+	dataframe result;
+	for (size_t k = 0; k < keys.size(); ++k) {
+		string_vector out(order.size());
+		for (size_t g = 0; g < order.size(); ++g) {
+			out[g] = (*key_columns[k])[groups[order[g].first].first_row[order[g].second]];
+		}
+		result[keys[k]] = out;
+	}
+	for (size_t a = 0; a < aggregations.size(); ++a) {
+		std::vector<double> out(order.size());
+		validity_bitmap valid(order.size());
+		for (size_t g = 0; g < order.size(); ++g) {
+			const aggregate_state& state = groups[order[g].first].states[order[g].second * aggregations.size() + a];
+			valid.set(g, state.result(aggregations[a].kind, out[g]));
+		}
+		std::string name = aggregations[a].output.empty()
+			? aggregations[a].column + "_" + aggregate_name(aggregations[a].kind)
+			: aggregations[a].output;
+		result[name] = string_vector::from_numeric(out, valid);
+	}
+	return result;
+}
+
+dataframe group_by(const dataframe_view& view, const std::vector<std::string>& keys, const std::vector<aggregation>& aggregations) {
+	return group_by(view.source(), keys, aggregations, view.selection());
+}
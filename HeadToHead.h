@@ -0,0 +1,159 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "Schema.h"
+
+// Open-addressing hash map from 64-bit integer keys: linear probing in a power-of-two table
+// that is kept at most half full. Keys are never erased; ~0 marks an empty slot.
+template <typename V>
+class flat_map64 {
+public:
+    static constexpr std::uint64_t EMPTY = ~std::uint64_t{ 0 };
+
+    flat_map64() {
+        rehash(6);
+    }
+
+    const V* find(std::uint64_t key) const {
+        for (size_t i = home_slot(key);; i = (i + 1) & mask) {
+            if (keys[i] == key) return &values[i];
+            if (keys[i] == EMPTY) return nullptr;
+        }
+    }
+
+    // The value stored under `key`, default-constructed on first use.
+    V& operator[](std::uint64_t key) {
+        if (2 * (count + 1) > keys.size()) rehash(bits + 1);
+        size_t i = home_slot(key);
+        while (keys[i] != key && keys[i] != EMPTY) {
+            i = (i + 1) & mask;
+        }
+        if (keys[i] == EMPTY) {
+            keys[i] = key;
+            ++count;
+        }
+        return values[i];
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+private:
+    std::vector<std::uint64_t> keys;
+    std::vector<V> values;
+    size_t count = 0;
+    size_t mask = 0;
+    int bits = 0;
+
+    // Fibonacci hashing: the top bits of key * 2^64/phi.
+    size_t home_slot(std::uint64_t key) const {
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+    }
+
+    void rehash(int new_bits) {
+        std::vector<std::uint64_t> old_keys = std::move(keys);
+        std::vector<V> old_values = std::move(values);
+        bits = new_bits;
+        keys.assign(size_t{ 1 } << bits, EMPTY);
+        values.assign(size_t{ 1 } << bits, V{});
+        mask = keys.size() - 1;
+        for (size_t j = 0; j < old_keys.size(); ++j) {
+            if (old_keys[j] == EMPTY) continue;
+            size_t i = home_slot(old_keys[j]);
+            while (keys[i] != EMPTY) {
+                i = (i + 1) & mask;
+            }
+            keys[i] = old_keys[j];
+            values[i] = std::move(old_values[j]);
+        }
+    }
+};
+
+// Meetings remembered per (home, away) pair.
+constexpr int H2H_MEETINGS = 5;
+
+// Averages over a pair's remembered meetings, from the home team's side; NaN without any.
+struct h2h_summary {
+    int meetings = 0;
+    double total = std::numeric_limits<double>::quiet_NaN();
+    double margin = std::numeric_limits<double>::quiet_NaN();
+    double pace = std::numeric_limits<double>::quiet_NaN();
+};
+
+// Ring of a pair's last H2H_MEETINGS meetings; the oldest is overwritten first.
+struct meeting_ring {
+    struct meeting {
+        double total, margin, pace;
+    };
+    meeting last[H2H_MEETINGS];
+    int count = 0;
+    int next = 0;
+
+    void push(const meeting& m) {
+        last[next] = m;
+        next = (next + 1) % H2H_MEETINGS;
+        if (count < H2H_MEETINGS) ++count;
+    }
+
+    h2h_summary summary() const {
+        h2h_summary s;
+        s.meetings = count;
+        if (count == 0) return s;
+        double total = 0, margin = 0, pace = 0;
+        for (int i = 0; i < count; ++i) {
+            total += last[i].total;
+            margin += last[i].margin;
+            pace += last[i].pace;
+        }
+        s.total = total / count;
+        s.margin = margin / count;
+        s.pace = pace / count;
+        return s;
+    }
+};
+
+// Head-to-head history keyed by the (home id, away id) pair packed into one integer, so a
+// lookup is one multiply and a short probe with no string hashing. Home and away are kept
+// apart: a pair's meetings are the games the same team hosted the same opponent.
+template <typename Schema>
+class head_to_head {
+public:
+    static std::uint64_t key(std::uint32_t home_id, std::uint32_t away_id) {
+        return (std::uint64_t{ home_id } << 32) | away_id;
+    }
+
+    h2h_summary summary(std::uint32_t home_id, std::uint32_t away_id) const {
+        const meeting_ring* ring = pairs.find(key(home_id, away_id));
+        return ring ? ring->summary() : h2h_summary{};
+    }
+
+    // The pair's summary before this game, then records the game (values as in lag_row).
+    h2h_summary update(std::uint32_t home_id, std::uint32_t away_id, const double* home_values, const double* away_values) {
+        meeting_ring& ring = pairs[key(home_id, away_id)];
+        h2h_summary before = ring.summary();
+        ring.push({
+            home_values[SCORE] + away_values[SCORE],
+            home_values[SCORE] - away_values[SCORE],
+            (possessions(home_values) + possessions(away_values)) * 0.5,
+        });
+        return before;
+    }
+
+private:
+    static constexpr int SCORE = stat_index<Schema>("SCORE");
+    static constexpr int FGA = stat_index<Schema>("FGA");
+    static constexpr int FTA = stat_index<Schema>("FTA");
+    static constexpr int OREB = stat_index<Schema>("OREB");
+    static constexpr int TOV = stat_index<Schema>("TOV");
+    static_assert(SCORE >= 0 && FGA >= 0 && FTA >= 0 && OREB >= 0 && TOV >= 0,
+        "head-to-head features need SCORE, FGA, FTA, OREB and TOV in the schema");
+
+    flat_map64<meeting_ring> pairs;
+
+    // Same estimate as the derived H_POSS / A_POSS columns.
+    static double possessions(const double* values) {
+        return values[FGA] + values[FTA] * 0.44 - values[OREB] + values[TOV];
+    }
+};
@@ -0,0 +1,204 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "DataFrame.h"
+#include "LaggedAverages.h"
+#include "Ratings.h"
+
+// One league's batch: its season files (oldest first, named "yyyy-yyyy.csv" so
+// modify_dates can infer the year), the lag window sizes to build and where the
+// final feature file is written. Each window after the first gets its own
+// "_w<size>" output next to `output`. Besides the CSV, the feature matrix can be
+// exported as .npy (same path, .npy extension) for zero-parse training.
+struct league_job {
+	std::string league;
+	std::vector<std::string> seasons;
+	std::vector<int> windows;
+	std::string output;
+	bool export_csv = true;
+	std::vector<npy_dtype> npy_exports{};
+	npy_order npy_layout = npy_order::row_major;
+	lag_options lags{};  // window_size is taken from `windows`
+	std::string correlation_target{}; // when set, also write feature correlation reports
+	bool describe = false; // write a per-column, per-season profile of the feature file as JSON
+	std::vector<std::string> subsets{}; // row subsets exported as their own feature files
+	rating_options ratings{}; // Elo and offense/defense ratings added in the rest-days pass
+};
+
+// Reads a job manifest. Relative paths are resolved against the manifest's directory.
+//
+//   # comment
+//   [nba]
+//   season = data/nba/2019-2020.csv
+//   season = data/nba/2020-2021.csv
+//   windows = 10            (comma separated, default 10)
+//   output = data/nba/data_file.csv
+//   export = csv, npy32     (any of csv, npy32, npy64; default csv)
+//   npy_order = row         (row or column)
+//   lag_mode = pipelined    (serial, pipelined or sharded)
+//   robust = on             (rolling median, IQR and trimmed mean of every lagged track; default off)
+//   ratings = on            (pre-game Elo and offense/defense ratings; seasons are then prepared in order)
+//   elo_k = 20              (K-factor of the emitted ratings, default 20)
+//   elo_home_advantage = 100
+//   rating_sweep_k = 10, 20, 30
+//   rating_sweep_home_advantage = 0, 50, 100
+//                           (every K x home advantage pair is scored in the same pass and
+//                            written to <output>_rating_sweep.csv)
+//   correlation = TOTAL     (target column of the correlation report; off when absent)
+//   describe = on           (count, nulls, NaN/inf, min/max, mean, std and quantiles of every
+//                            feature, overall and per season, in <output>_describe.json; default off)
+//   subsets = FAST_PACE, SEASON=2024-2025 & LOW_SCORING_SETUP
+//                           (flag columns or COLUMN=VALUE terms, '&' narrows; one file each)
+std::vector<league_job> load_manifest(const std::string& filename) {
+	std::ifstream file{ filename };
+	if (!file.is_open()) {
+		throw std::runtime_error("Could not open job manifest: " + filename);
+	}
+	const std::filesystem::path base = std::filesystem::path(filename).parent_path();
+	auto resolve = [&base](const std::string& path) {
+		std::filesystem::path p{ path };
+		return (p.is_absolute() ? p : base / p).lexically_normal().string();
+	};
+	auto trim = [](std::string text) {
+		size_t first = text.find_first_not_of(" \t\r");
+		size_t last = text.find_last_not_of(" \t\r");
+		return first == std::string::npos ? std::string{} : text.substr(first, last - first + 1);
+	};
+
+	auto numbers = [&trim](const std::string& value, const auto& fail) {
+		std::vector<double> result;
+		std::stringstream ss(value);
+		std::string number;
+		while (std::getline(ss, number, ',')) {
+			try {
+				result.push_back(std::stod(trim(number)));
+			}
+			catch (const std::exception&) {
+				fail("invalid number '" + number + "'");
+			}
+		}
+		return result;
+	};
+
+	std::vector<league_job> jobs;
+	std::string line;
+	int line_number = 0;
+	while (std::getline(file, line)) {
+		++line_number;
+		line = trim(line);
+		if (line.empty() || line[0] == '#') continue;
+
+		auto fail = [&](const std::string& what) {
+			throw std::runtime_error(filename + ":" + std::to_string(line_number) + ": " + what);
+		};
+		if (line.front() == '[') {
+			if (line.back() != ']') fail("unterminated section header");
+			jobs.push_back(league_job{});
+			jobs.back().league = trim(line.substr(1, line.size() - 2));
+			continue;
+		}
+		size_t eq = line.find('=');
+		if (eq == std::string::npos) fail("expected key = value");
+		if (jobs.empty()) fail("entry before the first [league] section");
+		std::string key = trim(line.substr(0, eq));
+		std::string value = trim(line.substr(eq + 1));
+		league_job& job = jobs.back();
+
+		if (key == "season") {
+			job.seasons.push_back(resolve(value));
+		}
+		else if (key == "output") {
+			job.output = resolve(value);
+		}
+		else if (key == "windows") {
+			std::stringstream ss(value);
+			std::string size;
+			while (std::getline(ss, size, ',')) {
+				try {
+					job.windows.push_back(std::stoi(trim(size)));
+				}
+				catch (const std::exception&) {
+					fail("invalid window size '" + size + "'");
+				}
+				if (job.windows.back() < 1) fail("window size must be positive");
+			}
+		}
+		else if (key == "export") {
+			job.export_csv = false;
+			job.npy_exports.clear();
+			std::stringstream ss(value);
+			std::string format;
+			while (std::getline(ss, format, ',')) {
+				format = trim(format);
+				if (format == "csv") job.export_csv = true;
+				else if (format == "npy32") job.npy_exports.push_back(npy_dtype::float32);
+				else if (format == "npy64") job.npy_exports.push_back(npy_dtype::float64);
+				else fail("unknown export format '" + format + "'");
+			}
+		}
+		else if (key == "npy_order") {
+			if (value == "row") job.npy_layout = npy_order::row_major;
+			else if (value == "column") job.npy_layout = npy_order::column_major;
+			else fail("npy_order must be row or column");
+		}
+		else if (key == "correlation") {
+			job.correlation_target = value;
+		}
+		else if (key == "describe") {
+			if (value == "on") job.describe = true;
+			else if (value == "off") job.describe = false;
+			else fail("describe must be on or off");
+		}
+		else if (key == "subsets") {
+			std::stringstream ss(value);
+			std::string subset;
+			while (std::getline(ss, subset, ',')) {
+				subset = trim(subset);
+				if (subset.empty()) fail("empty subset");
+				job.subsets.push_back(subset);
+			}
+		}
+		else if (key == "lag_mode") {
+			if (value == "serial") job.lags.mode = lag_mode::serial;
+			else if (value == "pipelined") job.lags.mode = lag_mode::pipelined;
+			else if (value == "sharded") job.lags.mode = lag_mode::sharded;
+			else fail("lag_mode must be serial, pipelined or sharded");
+		}
+		else if (key == "robust") {
+			if (value == "on") job.lags.robust = true;
+			else if (value == "off") job.lags.robust = false;
+			else fail("robust must be on or off");
+		}
+		else if (key == "ratings") {
+			if (value == "on") job.ratings.enabled = true;
+			else if (value == "off") job.ratings.enabled = false;
+			else fail("ratings must be on or off");
+		}
+		else if (key == "elo_k" || key == "elo_home_advantage") {
+			std::vector<double> number = numbers(value, fail);
+			if (number.size() != 1) fail(key + " takes one number");
+			(key == "elo_k" ? job.ratings.config.k : job.ratings.config.home_advantage) = number[0];
+		}
+		else if (key == "rating_sweep_k") {
+			job.ratings.sweep_k = numbers(value, fail);
+		}
+		else if (key == "rating_sweep_home_advantage") {
+			job.ratings.sweep_home_advantage = numbers(value, fail);
+		}
+		else {
+			fail("unknown key '" + key + "'");
+		}
+	}
+
+	for (auto& job : jobs) {
+		if (job.seasons.empty() || job.output.empty()) {
+			throw std::runtime_error(filename + ": league [" + job.league + "] needs at least one season and an output");
+		}
+		if (job.windows.empty()) job.windows.push_back(10);
+	}
+	return jobs;
+}
@@ -0,0 +1,490 @@
+#pragma once
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <exception>
+#include <unordered_map>
+#include "DataFrame.h"
+#include "Statistics.h"
+#include "SpscQueue.h"
+#include "Schema.h"
+#include "Parallel.h"
+#include "HeadToHead.h"
+
+enum class lag_mode { serial, pipelined, sharded };
+
+struct lag_options {
+    int window_size = 5;
+    lag_mode mode = lag_mode::serial;
+    bool robust = false; // also write each track's own-side median, IQR and trimmed mean
+};
+
+// One parsed input row. home_values/away_values hold that team's own stats followed by
+// the allowed stats its opponent scored against it (see schema_traits::tracks).
+template <typename Schema>
+struct lag_row {
+    std::string date, home, away;
+    double home_values[schema_traits<Schema>::tracks];
+    double away_values[schema_traits<Schema>::tracks];
+    std::string tail;
+};
+
+// One team's half of an output row.
+template <typename Schema>
+struct lag_half {
+    bool ready = false;
+    double averages[schema_traits<Schema>::tracks];
+    double stddev = 0.0;
+    double entropy = 0.0;
+    double conditional_entropy = 0.0;
+    robust_summary robust[schema_traits<Schema>::tracks]; // only filled when robust outputs are on
+};
+
+template <typename Schema>
+struct lag_output {
+    std::string date, home_team, away_team;
+    std::string tail;
+    lag_half<Schema> home, away;
+    h2h_summary h2h;
+};
+
+enum class side { home, away };
+
+// Last window_size + 1 values per track, split by where the team played. With robust
+// outputs on, `sorted` holds the same values in order.
+template <typename Schema>
+struct team_history {
+    std::deque<double> values[2][schema_traits<Schema>::tracks]; // [side][track]
+    order_statistic_window sorted[2][schema_traits<Schema>::tracks];
+};
+
+// Hands out the comma separated fields of a line as views into it.
+struct field_cursor {
+    std::string_view line;
+    size_t start = 0;
+
+    std::string_view next() {
+        size_t pos = line.find(',', start);
+        std::string_view field = line.substr(start, pos == std::string_view::npos ? std::string_view::npos : pos - start);
+        start = (pos == std::string_view::npos) ? line.size() : pos + 1;
+        return field;
+    }
+
+    std::string_view rest() const {
+        return line.substr(start);
+    }
+};
+
+// The field loop is unrolled over the schema, and the allowed stats are copied from
+// indices fixed at compile time.
+template <typename Schema>
+lag_row<Schema> parse_lag_row(const std::string& line) {
+    using traits = schema_traits<Schema>;
+    lag_row<Schema> row;
+    field_cursor fields{ line };
+    auto next_value = [&]() {
+        std::string_view field = fields.next();
+        double value;
+        if (!parse_double(field, value)) {
+            throw std::runtime_error("Lagged averages: invalid stat '" + std::string(field) + "' in row " + row.date + "," + row.home + "," + row.away);
+        }
+        return value;
+    };
+
+    row.date = fields.next();
+    row.home = fields.next();
+    row.away = fields.next();
+    static_for<traits::pairs>([&](auto i) {
+        row.home_values[i] = next_value();
+        row.away_values[i] = next_value();
+    });
+    static_for<traits::allowed>([&](auto k) {
+        constexpr int stat = traits::allowed_index[decltype(k)::value];
+        row.home_values[traits::pairs + k] = row.away_values[stat];
+        row.away_values[traits::pairs + k] = row.home_values[stat];
+    });
+    row.tail = fields.rest();
+    return row;
+}
+
+// Checks that the input header has the schema's H_/A_ pairs right after DATE,HOME,AWAY.
+template <typename Schema>
+void check_lag_header(const std::string& header, const std::string& filename) {
+    field_cursor fields{ header };
+    for (int i = 0; i < 3; ++i) fields.next();
+    for (std::string_view stat : Schema::stats) {
+        for (const char* prefix : { "H_", "A_" }) {
+            std::string expected = prefix + std::string(stat);
+            std::string_view found = fields.next();
+            if (found != expected) {
+                throw std::runtime_error("Lagged averages: expected column " + expected + " in " + filename + " but found '" + std::string(found) + "'");
+            }
+        }
+    }
+}
+
+// Records one game for one team and reports whether that side now holds a full window
+// (window_size previous games plus the current one).
+template <typename Schema>
+bool push_side(team_history<Schema>& team, side s, const double* values, const lag_options& options) {
+    constexpr int tracks = schema_traits<Schema>::tracks;
+    auto& history = team.values[static_cast<int>(s)];
+    auto& sorted = team.sorted[static_cast<int>(s)];
+    static_for<tracks>([&](auto i) {
+        history[i].push_back(values[i]);
+    });
+    if (options.robust) {
+        static_for<tracks>([&](auto i) {
+            sorted[i].insert(values[i]);
+        });
+    }
+    if (history[0].size() > size_t(options.window_size + 1)) {
+        if (options.robust) {
+            static_for<tracks>([&](auto i) {
+                sorted[i].erase(history[i].front());
+            });
+        }
+        static_for<tracks>([&](auto i) {
+            history[i].pop_front();
+        });
+    }
+    return history[0].size() == size_t(options.window_size + 1);
+}
+
+// The team's prediction for each track: home_weight from games on this side, the rest from the other side.
+// Own-side history is the `own_count` games before the newest `own_skip` ones (the game being
+// predicted, once update() has pushed it); the other side drops its newest game. Robust
+// outputs summarize the same own-side games, leaving the one history value outside them out
+// of the sorted window.
+template <typename Schema>
+void compute_half(const team_history<Schema>& team, side s, lag_half<Schema>& half, size_t own_skip, size_t own_count, bool robust) {
+    const auto& own = team.values[static_cast<int>(s)];
+    const auto& other = team.values[1 - static_cast<int>(s)];
+    const size_t own_end = own[0].size() - std::min(own_skip, own[0].size());
+    const size_t own_begin = own_end - std::min(own_count, own_end);
+    const size_t other_end = other[0].empty() ? 0 : other[0].size() - 1;
+    static_for<schema_traits<Schema>::tracks>([&](auto i) {
+        half.averages[i] = predict_next_score(own[i].begin() + own_begin, own[i].begin() + own_end) * Schema::home_weight +
+            predict_next_score(other[i].begin(), other[i].begin() + other_end) * (1.0 - Schema::home_weight);
+    });
+
+    std::deque<double> v(own[0].begin() + own_begin, own[0].begin() + own_end);
+    for (auto elem : other[0])
+        v.push_back(elem);
+    const double avg = mean(v);
+    half.stddev = standard_deviation(v, avg);
+    // The own-side window and the other-side history are two chronological runs; transitions
+    // are only counted inside each.
+    range_entropy_counter counter(avg, half.stddev);
+    counter.add_series(own[0].begin() + own_begin, own[0].begin() + own_end);
+    counter.add_series(other[0].begin(), other[0].end());
+    range_entropies entropies = counter.result();
+    half.entropy = entropies.entropy;
+    half.conditional_entropy = entropies.conditional_entropy;
+    if (robust) {
+        const auto& sorted = team.sorted[static_cast<int>(s)];
+        static_for<schema_traits<Schema>::tracks>([&](auto i) {
+            const double* excluded = own_end < own[i].size() ? &own[i].back() : own_begin > 0 ? &own[i].front() : nullptr;
+            half.robust[i] = summarize(sorted[i], excluded);
+        });
+    }
+    half.ready = true;
+}
+
+// Per-team state of the lagged-averages stage.
+template <typename Schema>
+class lag_state {
+public:
+    explicit lag_state(int window_size, bool robust = false) : options{ window_size, lag_mode::serial, robust } {}
+
+    // Updates both teams with the row and fills `out`; returns false while either team
+    // is still short of a full window (no output row is written for those games).
+    bool update(lag_row<Schema>& row, lag_output<Schema>& out) {
+        const std::uint32_t home_id = team_id(row.home);
+        const std::uint32_t away_id = team_id(row.away);
+        team_history<Schema>& home = histories[home_id];
+        team_history<Schema>& away = histories[away_id];
+        bool home_ready = push_side(home, side::home, row.home_values, options);
+        bool away_ready = push_side(away, side::away, row.away_values, options);
+        out.h2h = meetings.update(home_id, away_id, row.home_values, row.away_values);
+        out.home.ready = out.away.ready = false;
+        if (!home_ready || !away_ready) return false;
+
+        compute_half(home, side::home, out.home, 1, options.window_size, options.robust);
+        compute_half(away, side::away, out.away, 1, options.window_size, options.robust);
+        out.date = std::move(row.date);
+        out.home_team = std::move(row.home);
+        out.away_team = std::move(row.away);
+        out.tail = std::move(row.tail);
+        return true;
+    }
+
+    // The halves a game between `home` and `away` would get next, without recording it: the
+    // same windows update() would use once the game is pushed, read in place. Returns false
+    // while either team is short of a full window.
+    bool preview(const std::string& home, const std::string& away, lag_output<Schema>& out) const {
+        const std::uint32_t home_id = teams.find(home);
+        const std::uint32_t away_id = teams.find(away);
+        out.home.ready = out.away.ready = false;
+        if (home_id == category_dictionary::npos || away_id == category_dictionary::npos) return false;
+        const team_history<Schema>& home_team = histories[home_id];
+        const team_history<Schema>& away_team = histories[away_id];
+        const size_t window_size = options.window_size;
+        if (home_team.values[0][0].size() < window_size || away_team.values[1][0].size() < window_size) return false;
+
+        compute_half(home_team, side::home, out.home, 0, window_size, options.robust);
+        compute_half(away_team, side::away, out.away, 0, window_size, options.robust);
+        out.h2h = meetings.summary(home_id, away_id);
+        out.home_team = home;
+        out.away_team = away;
+        return true;
+    }
+
+private:
+    lag_options options;
+    category_dictionary teams;
+    std::deque<team_history<Schema>> histories; // indexed by team id
+    head_to_head<Schema> meetings;
+
+    std::uint32_t team_id(const std::string& name) {
+        std::uint32_t id = teams.encode(name);
+        if (id == histories.size()) histories.emplace_back();
+        return id;
+    }
+};
+
+template <typename Schema>
+void format_lag_output(std::ostringstream& stream, const lag_output<Schema>& out, bool robust) {
+    using traits = schema_traits<Schema>;
+    stream << out.date << "," << out.home_team << "," << out.away_team << ",";
+    static_for<traits::pairs>([&](auto i) {
+        stream << out.home.averages[i] << "," << out.away.averages[i] << ",";
+    });
+    stream << out.tail << ",";
+    static_for<traits::allowed>([&](auto k) {
+        stream << out.home.averages[traits::pairs + k] << "," << out.away.averages[traits::pairs + k] << ",";
+    });
+    stream << out.home.stddev << "," << out.away.stddev << ",";
+    stream << out.home.entropy << "," << out.away.entropy << ",";
+    stream << out.home.conditional_entropy << "," << out.away.conditional_entropy << ",";
+    stream << out.h2h.meetings;
+    for (double value : { out.h2h.total, out.h2h.margin, out.h2h.pace }) {
+        stream << ",";
+        if (out.h2h.meetings > 0) stream << value;
+    }
+    if (robust) {
+        for (double robust_summary::*statistic : { &robust_summary::median, &robust_summary::iqr, &robust_summary::trimmed_mean }) {
+            for (int i = 0; i < traits::tracks; ++i) {
+                stream << "," << out.home.robust[i].*statistic << "," << out.away.robust[i].*statistic;
+            }
+        }
+    }
+}
+
+template <typename Schema>
+void lagged_averages_serial(std::fstream& file, std::fstream& file2, const lag_options& options) {
+    lag_state<Schema> state(options.window_size, options.robust);
+    lag_output<Schema> out;
+    std::ostringstream stream;
+    std::string line;
+    while (std::getline(file, line)) {
+        lag_row<Schema> row = parse_lag_row<Schema>(line);
+        if (state.update(row, out)) {
+            format_lag_output(stream, out, options.robust);
+            stream << "\n";
+            file2 << stream.str();
+            stream.str("");
+        }
+    }
+}
+
+// Reader, compute and writer run on their own threads, connected by SPSC rings of row
+// batches, so reading/parsing, the team-state update and formatting/writing overlap.
+// An empty batch marks the end of the stream.
+template <typename Schema>
+void lagged_averages_pipelined(std::fstream& file, std::fstream& file2, const lag_options& options) {
+    constexpr size_t BATCH = 256;
+    constexpr size_t QUEUE_BATCHES = 16;
+    spsc_queue<std::vector<lag_row<Schema>>> parsed(QUEUE_BATCHES);
+    spsc_queue<std::vector<lag_output<Schema>>> computed(QUEUE_BATCHES);
+    std::exception_ptr reader_error;
+    const int stage = profile_current_stage();
+
+    std::thread reader([&]() {
+        profile_attach attach(stage);
+        std::vector<lag_row<Schema>> batch;
+        batch.reserve(BATCH);
+        std::string line;
+        try {
+            while (std::getline(file, line)) {
+                batch.push_back(parse_lag_row<Schema>(line));
+                if (batch.size() == BATCH) {
+                    parsed.push(std::move(batch));
+                    batch.clear();
+                    batch.reserve(BATCH);
+                }
+            }
+        }
+        catch (...) {
+            reader_error = std::current_exception();
+        }
+        if (!batch.empty()) parsed.push(std::move(batch));
+        parsed.push(std::vector<lag_row<Schema>>{});
+    });
+
+    std::thread compute([&]() {
+        profile_attach attach(stage);
+        lag_state<Schema> state(options.window_size, options.robust);
+        std::vector<lag_row<Schema>> batch;
+        for (;;) {
+            parsed.pop(batch);
+            if (batch.empty()) break;
+            std::vector<lag_output<Schema>> outputs;
+            outputs.reserve(batch.size());
+            lag_output<Schema> out;
+            for (auto& row : batch) {
+                if (state.update(row, out)) outputs.push_back(std::move(out));
+            }
+            if (!outputs.empty()) computed.push(std::move(outputs));
+        }
+        computed.push(std::vector<lag_output<Schema>>{});
+    });
+
+    std::ostringstream stream;
+    std::vector<lag_output<Schema>> outputs;
+    for (;;) {
+        computed.pop(outputs);
+        if (outputs.empty()) break;
+        for (const auto& out : outputs) {
+            format_lag_output(stream, out, options.robust);
+            stream << "\n";
+        }
+        file2 << stream.str();
+        stream.str("");
+    }
+    reader.join();
+    compute.join();
+    if (reader_error) std::rethrow_exception(reader_error);
+}
+
+// Teams are dealt to shards by team id, one shard per worker by default (a worker owns a run
+// of shards when there are more). Rows are read in blocks; every worker walks the whole block
+// but only records the sides of its own teams, writing each of their halves into the row's
+// slot. A team's two sides live on the same shard, so no history is shared between workers;
+// head-to-head pairs belong to the home team's shard. The halves are then merged in row
+// order and written, which gives output byte-identical to the serial mode.
+template <typename Schema>
+void lagged_averages_sharded(std::fstream& file, std::fstream& file2, const lag_options& options, size_t shards = parallel_width()) {
+    constexpr size_t BLOCK = 8192;
+    shards = std::max<size_t>(1, shards);
+    category_dictionary teams;
+    std::deque<team_history<Schema>> histories; // indexed by team id, each touched by one shard
+    std::vector<head_to_head<Schema>> meetings(shards);
+    std::vector<std::string> lines;
+    std::vector<lag_row<Schema>> rows;
+    std::vector<std::uint32_t> home_ids, away_ids;
+    std::vector<lag_output<Schema>> outputs;
+    std::ostringstream stream;
+    std::string line;
+
+    for (bool more = true; more;) {
+        lines.clear();
+        while (lines.size() < BLOCK && (more = static_cast<bool>(std::getline(file, line)))) {
+            lines.push_back(std::move(line));
+        }
+        if (lines.empty()) break;
+
+        const size_t count = lines.size();
+        rows.resize(count);
+        outputs.resize(count);
+        parallel_chunks(count, std::min(shards, parallel_width()), [&](size_t, size_t begin, size_t end) {
+            for (size_t r = begin; r < end; ++r) {
+                rows[r] = parse_lag_row<Schema>(lines[r]);
+            }
+        });
+        home_ids.resize(count);
+        away_ids.resize(count);
+        for (size_t r = 0; r < count; ++r) {
+            home_ids[r] = teams.encode(rows[r].home);
+            away_ids[r] = teams.encode(rows[r].away);
+            while (histories.size() < teams.size()) histories.emplace_back();
+        }
+
+        parallel_chunks(shards, std::min(shards, parallel_width()), [&](size_t, size_t first_shard, size_t last_shard) {
+            for (size_t r = 0; r < count; ++r) {
+                const size_t home_shard = home_ids[r] % shards, away_shard = away_ids[r] % shards;
+                lag_output<Schema>& out = outputs[r];
+                if (home_shard >= first_shard && home_shard < last_shard) {
+                    out.h2h = meetings[home_shard].update(home_ids[r], away_ids[r], rows[r].home_values, rows[r].away_values);
+                    team_history<Schema>& home = histories[home_ids[r]];
+                    out.home.ready = false;
+                    if (push_side(home, side::home, rows[r].home_values, options)) {
+                        compute_half(home, side::home, out.home, 1, options.window_size, options.robust);
+                    }
+                }
+                if (away_shard >= first_shard && away_shard < last_shard) {
+                    team_history<Schema>& away = histories[away_ids[r]];
+                    out.away.ready = false;
+                    if (push_side(away, side::away, rows[r].away_values, options)) {
+                        compute_half(away, side::away, out.away, 1, options.window_size, options.robust);
+                    }
+                }
+            }
+        });
+
+        for (size_t r = 0; r < count; ++r) {
+            lag_output<Schema>& out = outputs[r];
+            if (!out.home.ready || !out.away.ready) continue;
+            out.date = std::move(rows[r].date);
+            out.home_team = std::move(rows[r].home);
+            out.away_team = std::move(rows[r].away);
+            out.tail = std::move(rows[r].tail);
+            format_lag_output(stream, out, options.robust);
+            stream << "\n";
+        }
+        file2 << stream.str();
+        stream.str("");
+    }
+}
+
+// The lag stage for one schema. A league with a different column layout declares its own
+// schema struct and calls this with it.
+template <typename Schema>
+void create_lagged_averages(const std::string& filename1, const std::string& filename2, const lag_options& options) {
+    FE_PROFILE_SCOPE("lagged_averages");
+    std::fstream file{ filename1, std::ios::in };
+    std::fstream file2{ filename2, std::ios::out };
+    if (!file.is_open() || !file2.is_open()) {
+        std::cerr << "Error opening files!" << std::endl;
+        return;
+    }
+
+    std::string header;
+    std::getline(file, header); //read header
+    check_lag_header<Schema>(header, filename1);
+    //file2 << header << R"(,H_FG%_ALLOWED,A_FG%_ALLOWED,H_2FG%_ALLOWED,A_2FG%_ALLOWED,H_3FG%_ALLOWED,A_3FG%_ALLOWED,H_TOV_ALLOWED,A_TOV_ALLOWED,H_ENTROPY,A_ENTROPY,H_COND_ENTROPY,A_COND_ENTROPY,H_SKEW,A_SKEW,H_KURTOSIS,A_KURTOSIS)";
+    file2 << header << lagged_columns<Schema>(options.robust) << "\n";
+
+    if (options.mode == lag_mode::pipelined)
+        lagged_averages_pipelined<Schema>(file, file2, options);
+    else if (options.mode == lag_mode::sharded)
+        lagged_averages_sharded<Schema>(file, file2, options);
+    else
+        lagged_averages_serial<Schema>(file, file2, options);
+
+    file.close();
+    file2.close();
+}
+
+// NBA and B-League exports share the NBA layout.
+void calculate_and_create_lagged_averages(const std::string& filename1, const std::string& filename2, const lag_options& options) {
+    create_lagged_averages<nba_schema>(filename1, filename2, options);
+}
+
+void calculate_and_create_lagged_averages(const std::string& filename1, const std::string& filename2, int window_size = 5) {
+    calculate_and_create_lagged_averages(filename1, filename2, lag_options{ window_size });
+}
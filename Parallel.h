@@ -0,0 +1,230 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <utility>
+#include <algorithm>
+#include "Profiler.h"
+
+size_t worker_count() {
+	unsigned int n = std::thread::hardware_concurrency();
+	return n == 0 ? 1 : n;
+}
+
+// Workers a parallel operator started on this thread may use; 0 means worker_count(). The
+// threads of parallel_chunks and parallel_morsels set it to 1, so an operator nested inside
+// another runs inline, and thread_pool workers set it to the pool's task width, so jobs
+// running side by side share the cores instead of each starting a full set of threads.
+thread_local size_t thread_workers = 0;
+
+size_t parallel_width() {
+	return thread_workers ? thread_workers : worker_count();
+}
+
+// Splits [0, count) into one contiguous chunk per worker and calls fn(worker, begin, end)
+// for each chunk on its own thread. The first exception thrown by a worker is rethrown here.
+// Workers run under the caller's profiling stage and run any nested operator inline.
+template <typename Fn>
+void parallel_chunks(size_t count, size_t workers, Fn fn) {
+	workers = std::max<size_t>(1, std::min(workers, count));
+	if (workers == 1) {
+		fn(size_t{ 0 }, size_t{ 0 }, count);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	std::vector<std::exception_ptr> errors(workers);
+	const int stage = profile_current_stage();
+	size_t chunk = (count + workers - 1) / workers;
+	for (size_t w = 0; w < workers; ++w) {
+		size_t begin = std::min(count, w * chunk);
+		size_t end = std::min(count, begin + chunk);
+		threads.emplace_back([&, w, begin, end]() {
+			profile_attach attach(stage);
+			thread_workers = 1;
+			try {
+				fn(w, begin, end);
+			}
+			catch (...) {
+				errors[w] = std::current_exception();
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	for (auto& error : errors) {
+		if (error) std::rethrow_exception(error);
+	}
+}
+
+template <typename Fn>
+void parallel_chunks(size_t count, Fn fn) {
+	parallel_chunks(count, parallel_width(), fn);
+}
+
+// Splits [0, count) into morsels of `morsel` items and calls fn(worker, begin, end) once per
+// morsel. Every worker starts on its own contiguous run of morsels and takes them from the
+// front; a worker whose run is empty steals morsels from the back of the others' runs. A run
+// is one atomic (front, back) pair, so claiming a morsel is a single compare-and-swap.
+// Like parallel_chunks, it uses parallel_width() workers and runs nested operators inline.
+template <typename Fn>
+void parallel_morsels(size_t count, size_t morsel, Fn fn) {
+	morsel = std::max<size_t>(1, morsel);
+	const size_t morsels = (count + morsel - 1) / morsel;
+	const size_t workers = std::max<size_t>(1, std::min(parallel_width(), morsels));
+	if (workers == 1) {
+		for (size_t begin = 0; begin < count; begin += morsel) {
+			fn(size_t{ 0 }, begin, std::min(count, begin + morsel));
+		}
+		return;
+	}
+
+	struct alignas(64) morsel_run {
+		std::atomic<std::uint64_t> range{ 0 }; // front << 32 | back
+	};
+	auto pack = [](std::uint64_t front, std::uint64_t back) { return (front << 32) | back; };
+	auto claim = [](morsel_run& run, bool from_front, size_t& taken) {
+		std::uint64_t range = run.range.load(std::memory_order_relaxed);
+		for (;;) {
+			std::uint64_t front = range >> 32;
+			std::uint64_t back = range & 0xFFFFFFFFu;
+			if (front >= back) return false;
+			std::uint64_t next = from_front ? ((front + 1) << 32) | back : (front << 32) | (back - 1);
+			if (run.range.compare_exchange_weak(range, next, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+				taken = static_cast<size_t>(from_front ? front : back - 1);
+				return true;
+			}
+		}
+	};
+
+	std::unique_ptr<morsel_run[]> runs(new morsel_run[workers]);
+	for (size_t w = 0; w < workers; ++w) {
+		runs[w].range = pack(w * morsels / workers, (w + 1) * morsels / workers);
+	}
+	std::vector<std::thread> threads;
+	std::vector<std::exception_ptr> errors(workers);
+	const int stage = profile_current_stage();
+	for (size_t w = 0; w < workers; ++w) {
+		threads.emplace_back([&, w]() {
+			profile_attach attach(stage);
+			thread_workers = 1;
+			auto process = [&](size_t m) {
+				size_t begin = m * morsel;
+				fn(w, begin, std::min(count, begin + morsel));
+			};
+			try {
+				size_t m;
+				while (claim(runs[w], true, m)) process(m);
+				for (size_t k = 1; k < workers; ++k) {
+					morsel_run& victim = runs[(w + k) % workers];
+					while (claim(victim, false, m)) process(m);
+				}
+			}
+			catch (...) {
+				errors[w] = std::current_exception();
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	for (auto& error : errors) {
+		if (error) std::rethrow_exception(error);
+	}
+}
+
+// Fixed set of worker threads shared by every job in a batch run. Tasks may submit
+// follow-up tasks (a finished stage queuing the next one), so nothing ever blocks a
+// worker waiting on another task. wait_idle() returns once the queue is drained and
+// no task is running; the first exception thrown by a task is rethrown there.
+// Parallel operators inside a task use at most `task_width` workers (0: worker_count()).
+class thread_pool {
+public:
+	explicit thread_pool(size_t threads = worker_count(), size_t task_width = 0) {
+		for (size_t i = 0; i < std::max<size_t>(1, threads); ++i) {
+			workers.emplace_back([this, task_width]() {
+				thread_workers = task_width;
+				run();
+			});
+		}
+	}
+
+	~thread_pool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		task_ready.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	size_t size() const {
+		return workers.size();
+	}
+
+	void submit(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back(std::move(task));
+		}
+		task_ready.notify_one();
+	}
+
+	void wait_idle() {
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this]() { return tasks.empty() && active == 0; });
+		if (error) {
+			std::exception_ptr first = std::exchange(error, nullptr);
+			std::rethrow_exception(first);
+		}
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable task_ready;
+	std::condition_variable idle;
+	size_t active = 0;
+	bool stopping = false;
+	std::exception_ptr error;
+
+	void run() {
+		for (;;) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				task_ready.wait(lock, [this]() { return stopping || !tasks.empty(); });
+				if (tasks.empty()) return;
+				task = std::move(tasks.front());
+				tasks.pop_front();
+				++active;
+			}
+			try {
+				task();
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!error) error = std::current_exception();
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				--active;
+				if (tasks.empty() && active == 0) idle.notify_all();
+			}
+		}
+	}
+};
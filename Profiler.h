@@ -0,0 +1,193 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <new>
+
+// Per-stage timing, and with FE_PROFILE_ALLOCATIONS defined, per-stage allocation counts.
+// A stage is any block opened with FE_PROFILE_SCOPE("name"); scopes nest per thread. Time
+// is inclusive of nested scopes and adds up across threads running the same stage.
+// Allocations are charged to the innermost open scope of the allocating thread, and a
+// block's bytes stay live against that stage until it is freed, wherever that happens.
+constexpr int MAX_PROFILE_STAGES = 64;
+
+struct profile_stage {
+	const char* name = nullptr;
+	std::atomic<std::uint64_t> calls{ 0 };
+	std::atomic<std::uint64_t> nanoseconds{ 0 };
+	std::atomic<std::uint64_t> allocations{ 0 };
+	std::atomic<std::uint64_t> bytes{ 0 };
+	std::atomic<std::int64_t> live{ 0 };
+	std::atomic<std::int64_t> peak{ 0 };
+};
+
+// Stage 0 collects everything that runs outside a scope.
+profile_stage profile_stages[MAX_PROFILE_STAGES];
+int profile_stage_count = 1;
+std::mutex profile_registry_mutex;
+thread_local int profile_current = 0;
+
+// Id of the named stage, registering it on first use. Names must outlive the program
+// (string literals). Stages beyond the table are folded into stage 0.
+int profile_register(const char* name) {
+	std::lock_guard<std::mutex> lock(profile_registry_mutex);
+	for (int i = 1; i < profile_stage_count; ++i) {
+		if (std::strcmp(profile_stages[i].name, name) == 0) return i;
+	}
+	if (profile_stage_count == MAX_PROFILE_STAGES) return 0;
+	profile_stages[profile_stage_count].name = name;
+	return profile_stage_count++;
+}
+
+int profile_current_stage() {
+	return profile_current;
+}
+
+// Makes `stage` the current stage of this thread without timing it; worker threads use
+// it to charge their allocations to the stage that spawned them.
+class profile_attach {
+public:
+	explicit profile_attach(int stage) : previous(profile_current) {
+		profile_current = stage;
+	}
+
+	~profile_attach() {
+		profile_current = previous;
+	}
+
+	profile_attach(const profile_attach&) = delete;
+	profile_attach& operator=(const profile_attach&) = delete;
+
+private:
+	int previous;
+};
+
+class profile_scope {
+public:
+	explicit profile_scope(int stage) : stage(stage), attach(stage), start(std::chrono::steady_clock::now()) {
+		profile_stages[stage].calls.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	~profile_scope() {
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+		profile_stages[stage].nanoseconds.fetch_add(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+	}
+
+private:
+	int stage;
+	profile_attach attach;
+	std::chrono::steady_clock::time_point start;
+};
+
+#define FE_PROFILE_CONCAT_(a, b) a##b
+#define FE_PROFILE_CONCAT(a, b) FE_PROFILE_CONCAT_(a, b)
+#define FE_PROFILE_SCOPE(name) \
+	static const int FE_PROFILE_CONCAT(fe_profile_stage_, __LINE__) = profile_register(name); \
+	profile_scope FE_PROFILE_CONCAT(fe_profile_scope_, __LINE__)(FE_PROFILE_CONCAT(fe_profile_stage_, __LINE__))
+
+#ifdef FE_PROFILE_ALLOCATIONS
+constexpr bool profile_tracks_allocations = true;
+
+// Every block carries its size and owning stage in front of it, so frees can be charged
+// back. Over-aligned allocations use the library's aligned operators and are not counted.
+struct alignas(16) allocation_header {
+	std::size_t size;
+	int stage;
+};
+
+void* profile_allocate(std::size_t size) {
+	auto* header = static_cast<allocation_header*>(std::malloc(sizeof(allocation_header) + size));
+	if (!header) return nullptr;
+	header->size = size;
+	header->stage = profile_current;
+	profile_stage& stage = profile_stages[header->stage];
+	stage.allocations.fetch_add(1, std::memory_order_relaxed);
+	stage.bytes.fetch_add(size, std::memory_order_relaxed);
+	std::int64_t live = stage.live.fetch_add(static_cast<std::int64_t>(size), std::memory_order_relaxed) + static_cast<std::int64_t>(size);
+	std::int64_t peak = stage.peak.load(std::memory_order_relaxed);
+	while (live > peak && !stage.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+	return header + 1;
+}
+
+void profile_release(void* block) {
+	if (!block) return;
+	auto* header = static_cast<allocation_header*>(block) - 1;
+	profile_stages[header->stage].live.fetch_sub(static_cast<std::int64_t>(header->size), std::memory_order_relaxed);
+	std::free(header);
+}
+
+void* operator new(std::size_t size) {
+	if (void* block = profile_allocate(size)) return block;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+	if (void* block = profile_allocate(size)) return block;
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	return profile_allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return profile_allocate(size);
+}
+
+void operator delete(void* block) noexcept {
+	profile_release(block);
+}
+
+void operator delete[](void* block) noexcept {
+	profile_release(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept {
+	profile_release(block);
+}
+
+void operator delete[](void* block, std::size_t) noexcept {
+	profile_release(block);
+}
+
+void operator delete(void* block, const std::nothrow_t&) noexcept {
+	profile_release(block);
+}
+
+void operator delete[](void* block, const std::nothrow_t&) noexcept {
+	profile_release(block);
+}
+#else
+constexpr bool profile_tracks_allocations = false;
+#endif
+
+// One line per stage that ran or allocated, in first-use order.
+void profile_report(std::ostream& out) {
+	out << std::left << std::setw(28) << "stage" << std::right << std::setw(8) << "calls" << std::setw(12) << "time (ms)";
+	if (profile_tracks_allocations) {
+		out << std::setw(12) << "allocs" << std::setw(14) << "bytes" << std::setw(14) << "peak live";
+	}
+	out << "\n";
+	int stages;
+	{
+		std::lock_guard<std::mutex> lock(profile_registry_mutex);
+		stages = profile_stage_count;
+	}
+	for (int i = 0; i < stages; ++i) {
+		const profile_stage& stage = profile_stages[i];
+		if (stage.calls == 0 && stage.allocations == 0) continue;
+		out << std::left << std::setw(28) << (i == 0 ? "(outside stages)" : stage.name) << std::right
+			<< std::setw(8) << stage.calls.load()
+			<< std::setw(12) << std::fixed << std::setprecision(1) << stage.nanoseconds.load() / 1e6;
+		if (profile_tracks_allocations) {
+			out << std::setw(12) << stage.allocations.load() << std::setw(14) << stage.bytes.load() << std::setw(14) << stage.peak.load();
+		}
+		out << "\n";
+	}
+	out << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,220 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "DataFrame.h"
+#include "Date.h"
+
+// Elo parameters: K-factor and the Elo points the home side plays with.
+struct rating_config {
+    double k = 20.0;
+    double home_advantage = 100.0;
+};
+
+// Ratings of a league run. `sweep_k` x `sweep_home_advantage` lists extra Elo configurations
+// scored alongside the emitted one; an empty list stands for the emitted configuration's value.
+struct rating_options {
+    bool enabled = false;
+    rating_config config{};
+    std::vector<double> sweep_k{};
+    std::vector<double> sweep_home_advantage{};
+};
+
+constexpr double ELO_START = 1500.0;
+constexpr double ELO_SEASON_CARRY = 0.75;     // share of a rating kept over the summer, the rest regresses to ELO_START
+constexpr double OFF_DEF_RATE = 0.05;         // share of a points surprise added to the offense/defense ratings
+constexpr double OFF_DEF_SEASON_CARRY = 0.75;
+constexpr double ELO_MARGIN_DIFF_LIMIT = 1000.0; // |Elo gap| the margin multiplier sees, keeping its denominator >= 1.5
+
+// Columns the rest-days pass appends when ratings are on.
+const std::vector<std::string>& rating_columns() {
+    static const std::vector<std::string> columns = {
+        "H_ELO", "A_ELO", "H_OFF_ELO", "A_OFF_ELO", "H_DEF_ELO", "A_DEF_ELO", "ELO_WIN_PROB",
+    };
+    return columns;
+}
+
+// Pre-game ratings of one game, in rating_columns() order. Offense is the points a team
+// scores above the league average, defense the points it allows above it (lower is better).
+struct game_ratings {
+    double values[7];
+};
+
+// Log loss and Brier score of one Elo configuration's pre-game home win probabilities.
+struct sweep_result {
+    rating_config config;
+    size_t games = 0;
+    double log_loss = 0.0;
+    double brier = 0.0;
+};
+
+// Margin-adjusted Elo plus offense/defense point ratings, carried across seasons. Games are
+// fed oldest first; the first game of a new season regresses every rating toward the mean.
+// State is one flat array per quantity indexed by team id (Elo: team-major, one slot per
+// configuration), so a game costs O(1) per configuration. Configuration 0 is the one whose
+// ratings are emitted; the others only accumulate their forecast scores.
+class rating_engine {
+public:
+    explicit rating_engine(const rating_options& options) {
+        configs.push_back(options.config);
+        if (!options.sweep_k.empty() || !options.sweep_home_advantage.empty()) {
+            const std::vector<double> ks = options.sweep_k.empty() ? std::vector<double>{ options.config.k } : options.sweep_k;
+            const std::vector<double> home_advantages = options.sweep_home_advantage.empty()
+                ? std::vector<double>{ options.config.home_advantage } : options.sweep_home_advantage;
+            for (double k : ks) {
+                for (double home_advantage : home_advantages) {
+                    configs.push_back({ k, home_advantage });
+                }
+            }
+        }
+        scores.resize(configs.size());
+        for (size_t c = 0; c < configs.size(); ++c) {
+            scores[c].config = configs[c];
+        }
+    }
+
+    // The ratings going into the game, then the result folded in.
+    game_ratings update(std::string_view date, std::string_view home, std::string_view away, double home_score, double away_score) {
+        start_season(season_of(date));
+        const std::uint32_t h = team_id(home);
+        const std::uint32_t a = team_id(away);
+        game_ratings before = ratings_of(h, a);
+
+        const double outcome = home_score > away_score ? 1.0 : home_score < away_score ? 0.0 : 0.5;
+        const double margin = std::abs(home_score - away_score);
+        const size_t n = configs.size();
+        for (size_t c = 0; c < n; ++c) {
+            double& home_elo = elo[h * n + c];
+            double& away_elo = elo[a * n + c];
+            const double diff = home_elo + configs[c].home_advantage - away_elo;
+            const double p = win_probability(diff);
+
+            sweep_result& score = scores[c];
+            const double clamped = std::clamp(p, 1e-15, 1.0 - 1e-15);
+            score.log_loss -= outcome * std::log(clamped) + (1.0 - outcome) * std::log(1.0 - clamped);
+            score.brier += (p - outcome) * (p - outcome);
+            ++score.games;
+
+            // 538-style margin multiplier: bigger wins count more, but less so for favourites.
+            // An upset by 1250+ Elo points would zero the denominator, so the gap is clamped.
+            const double winner_diff = std::clamp(outcome >= 0.5 ? diff : -diff, -ELO_MARGIN_DIFF_LIMIT, ELO_MARGIN_DIFF_LIMIT);
+            const double multiplier = std::pow(margin + 3.0, 0.8) / (7.5 + 0.006 * winner_diff);
+            const double shift = configs[c].k * multiplier * (outcome - p);
+            home_elo += shift;
+            away_elo -= shift;
+        }
+
+        const double expected_home = league_points + home_edge + offense[h] + defense[a];
+        const double expected_away = league_points - home_edge + offense[a] + defense[h];
+        if (games > 0) {
+            offense[h] += OFF_DEF_RATE * (home_score - expected_home);
+            defense[a] += OFF_DEF_RATE * (home_score - expected_home);
+            offense[a] += OFF_DEF_RATE * (away_score - expected_away);
+            defense[h] += OFF_DEF_RATE * (away_score - expected_away);
+        }
+        ++games;
+        league_points += ((home_score + away_score) * 0.5 - league_points) / games;
+        home_edge += ((home_score - away_score) * 0.5 - home_edge) / games;
+        return before;
+    }
+
+    // The ratings a game on `date` would go in with, without recording anything.
+    game_ratings preview(std::string_view date, std::string_view home, std::string_view away) const {
+        const bool new_season = season_of(date) != season;
+        auto carried = [new_season](double value, double carry, double mean) {
+            return new_season ? mean + (value - mean) * carry : value;
+        };
+        const std::uint32_t h = teams.find(home);
+        const std::uint32_t a = teams.find(away);
+        const size_t n = configs.size();
+        const double home_elo = carried(h == category_dictionary::npos ? ELO_START : elo[h * n], ELO_SEASON_CARRY, ELO_START);
+        const double away_elo = carried(a == category_dictionary::npos ? ELO_START : elo[a * n], ELO_SEASON_CARRY, ELO_START);
+        auto point_rating = [&](const std::vector<double>& ratings, std::uint32_t team) {
+            return carried(team == category_dictionary::npos ? 0.0 : ratings[team], OFF_DEF_SEASON_CARRY, 0.0);
+        };
+        return { {
+            home_elo, away_elo,
+            point_rating(offense, h), point_rating(offense, a),
+            point_rating(defense, h), point_rating(defense, a),
+            win_probability(home_elo + configs[0].home_advantage - away_elo),
+        } };
+    }
+
+    bool sweeping() const {
+        return configs.size() > 1;
+    }
+
+    // Per-game averages of every configuration's forecast scores so far; the emitted
+    // configuration comes first.
+    std::vector<sweep_result> sweep_results() const {
+        std::vector<sweep_result> results = scores;
+        for (auto& result : results) {
+            if (result.games == 0) continue;
+            result.log_loss /= double(result.games);
+            result.brier /= double(result.games);
+        }
+        return results;
+    }
+
+private:
+    std::vector<rating_config> configs;
+    std::vector<sweep_result> scores;
+    category_dictionary teams;
+    std::vector<double> elo;      // [team * configs + config]
+    std::vector<double> offense;  // [team]
+    std::vector<double> defense;  // [team]
+    std::string season;
+    double league_points = 0.0;   // mean points per team and game so far
+    double home_edge = 0.0;       // mean half home margin so far
+    size_t games = 0;
+
+    static double win_probability(double elo_diff) {
+        return 1.0 / (1.0 + std::pow(10.0, -elo_diff / 400.0));
+    }
+
+    std::uint32_t team_id(std::string_view name) {
+        std::uint32_t id = teams.encode(name);
+        if (id == offense.size()) {
+            elo.resize(elo.size() + configs.size(), ELO_START);
+            offense.push_back(0.0);
+            defense.push_back(0.0);
+        }
+        return id;
+    }
+
+    void start_season(const std::string& label) {
+        if (label == season) return;
+        if (!season.empty()) {
+            for (double& value : elo) value = ELO_START + (value - ELO_START) * ELO_SEASON_CARRY;
+            for (double& value : offense) value *= OFF_DEF_SEASON_CARRY;
+            for (double& value : defense) value *= OFF_DEF_SEASON_CARRY;
+        }
+        season = label;
+    }
+
+    game_ratings ratings_of(std::uint32_t h, std::uint32_t a) const {
+        const size_t n = configs.size();
+        return { {
+            elo[h * n], elo[a * n],
+            offense[h], offense[a], defense[h], defense[a],
+            win_probability(elo[h * n] + configs[0].home_advantage - elo[a * n]),
+        } };
+    }
+};
+
+// One line per configuration: K, home advantage, games, mean log loss and Brier score.
+void save_rating_sweep(const std::vector<sweep_result>& results, const std::string& filename) {
+    std::ofstream file{ filename };
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not write rating sweep " + filename);
+    }
+    file << "K,HOME_ADVANTAGE,GAMES,LOG_LOSS,BRIER\n";
+    for (const auto& result : results) {
+        file << result.config.k << "," << result.config.home_advantage << "," << result.games << ","
+            << result.log_loss << "," << result.brier << "\n";
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+// Reads a text file from the end in large blocks and hands out its lines last to first,
+// so a newest-first file can be walked chronologically without loading it. The first
+// line (the header) is read up front and never returned by next(). Memory use is one
+// block plus the longest line.
+class reverse_line_reader {
+public:
+	explicit reverse_line_reader(const std::string& filename, size_t block_size = size_t{ 1 } << 20)
+		: file(filename, std::ios::in | std::ios::binary), block(std::max<size_t>(block_size, 1)) {
+		if (!file.is_open()) return;
+		file.seekg(0, std::ios::end);
+		position = static_cast<long long>(file.tellg());
+		file.seekg(0);
+		std::getline(file, header_line);
+		if (!header_line.empty() && header_line.back() == '\r') header_line.pop_back();
+		lower = file.eof() ? position : static_cast<long long>(file.tellg());
+		fill();
+		// A final line terminator does not start another (empty) line.
+		if (end > 0 && buffer[end - 1] == '\n') --end;
+	}
+
+	bool is_open() const {
+		return file.is_open();
+	}
+
+	const std::string& header() const {
+		return header_line;
+	}
+
+	// Yields the previous line (without its terminator). The view stays valid until the next call.
+	bool next(std::string_view& line) {
+		for (;;) {
+			size_t i = end;
+			while (i > 0 && buffer[i - 1] != '\n') --i;
+			if (i > 0) {
+				line = trim(i, end);
+				end = i - 1;
+				return true;
+			}
+			if (position > lower) {
+				fill();
+				continue;
+			}
+			if (exhausted) return false;
+			exhausted = true;
+			line = trim(0, end);
+			end = 0;
+			return true;
+		}
+	}
+
+private:
+	std::ifstream file;
+	std::string header_line;
+	size_t block;
+	long long lower = 0;    // offset of the first data line
+	long long position = 0; // file offset of buffer[0]
+	std::vector<char> buffer;
+	size_t end = 0;         // buffer[0, end) is still unread
+	bool exhausted = false;
+
+	// Prepends the previous block of the file to the unread part of the buffer.
+	void fill() {
+		size_t chunk = static_cast<size_t>(std::min<long long>(static_cast<long long>(block), position - lower));
+		if (buffer.size() < chunk + end) buffer.resize(chunk + end);
+		std::memmove(buffer.data() + chunk, buffer.data(), end);
+		position -= static_cast<long long>(chunk);
+		file.clear();
+		file.seekg(position);
+		file.read(buffer.data(), static_cast<std::streamsize>(chunk));
+		end += chunk;
+		if (position == lower && end == 0) exhausted = true;
+	}
+
+	std::string_view trim(size_t first, size_t last) const {
+		if (last > first && buffer[last - 1] == '\r') --last;
+		return std::string_view(buffer.data() + first, last - first);
+	}
+};
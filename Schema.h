@@ -0,0 +1,111 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Column layout of a combined season file, declared once per league. After DATE,HOME,AWAY
+// the file holds one H_/A_ pair per entry of `stats`, in order; whatever follows (TOTAL, rest
+// days, ...) is passed through untouched. `allowed` names the stats every team also tracks for
+// what its opponents scored against it, and `home_weight` is the share of a lagged average
+// taken from games played on the same side (home or away).
+struct nba_schema {
+    static constexpr std::string_view stats[] = {
+        "SCORE", "FGA", "FG", "FG%", "2FGA", "2FG", "2FG%", "3FGA", "3FG", "3FG%", "FTA", "FT", "FT%",
+        "OREB", "DREB", "TREB", "AST", "BLKS", "TOV", "STL", "P_FOULS", "OFF_RATING", "DEF_RATING",
+    };
+    static constexpr std::string_view allowed[] = { "FG%", "2FG%", "3FG%", "TOV" };
+    static constexpr double home_weight = 0.6;
+};
+
+// Position of a stat in the schema's pair list, or -1.
+template <typename Schema>
+constexpr int stat_index(std::string_view name) {
+    for (size_t i = 0; i < std::size(Schema::stats); ++i) {
+        if (Schema::stats[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+template <typename Schema>
+constexpr std::array<int, std::size(Schema::allowed)> allowed_indices() {
+    std::array<int, std::size(Schema::allowed)> indices{};
+    for (size_t k = 0; k < indices.size(); ++k) {
+        indices[k] = stat_index<Schema>(Schema::allowed[k]);
+    }
+    return indices;
+}
+
+template <typename Schema>
+constexpr bool allowed_resolved() {
+    for (int index : allowed_indices<Schema>()) {
+        if (index < 0) return false;
+    }
+    return true;
+}
+
+// Everything the lag stage needs to know about a schema, resolved at compile time.
+// Tracks are the schema's stats followed by the allowed stats.
+template <typename Schema>
+struct schema_traits {
+    static constexpr int pairs = static_cast<int>(std::size(Schema::stats));
+    static constexpr int allowed = static_cast<int>(std::size(Schema::allowed));
+    static constexpr int tracks = pairs + allowed;
+    static constexpr std::array<int, std::size(Schema::allowed)> allowed_index = allowed_indices<Schema>();
+    static_assert(allowed_resolved<Schema>(), "every allowed stat must name one of the schema's stats");
+};
+
+// Calls f(std::integral_constant<size_t, I>{}) for I = 0..N-1, unrolled at compile time.
+template <typename F, size_t... I>
+constexpr void static_for(F&& f, std::index_sequence<I...>) {
+    (f(std::integral_constant<size_t, I>{}), ...);
+}
+
+template <size_t N, typename F>
+constexpr void static_for(F&& f) {
+    static_for(std::forward<F>(f), std::make_index_sequence<N>{});
+}
+
+// Name of a track: the stat itself, or "<stat>_ALLOWED" for an allowed stat.
+template <typename Schema>
+std::string track_name(int track) {
+    constexpr int pairs = schema_traits<Schema>::pairs;
+    return track < pairs ? std::string(Schema::stats[track]) : std::string(Schema::allowed[track - pairs]) + "_ALLOWED";
+}
+
+// H_/A_ columns of the robust lag outputs: every track's median, then every track's IQR,
+// then every track's trimmed mean.
+template <typename Schema>
+std::vector<std::string> robust_lag_columns() {
+    std::vector<std::string> columns;
+    for (const char* statistic : { "_MEDIAN", "_IQR", "_TRIMMED_MEAN" }) {
+        for (int track = 0; track < schema_traits<Schema>::tracks; ++track) {
+            columns.push_back("H_" + track_name<Schema>(track) + statistic);
+            columns.push_back("A_" + track_name<Schema>(track) + statistic);
+        }
+    }
+    return columns;
+}
+
+// Columns the lag stage appends to the input header: H_/A_ pairs for each allowed stat,
+// then the standard deviations, entropies and conditional entropies of the score history,
+// the head-to-head averages of the pairing, and the robust outputs when they are enabled.
+template <typename Schema>
+std::string lagged_columns(bool robust = false) {
+    std::string columns;
+    for (std::string_view name : Schema::allowed) {
+        columns += ",H_" + std::string(name) + "_ALLOWED,A_" + std::string(name) + "_ALLOWED";
+    }
+    columns += ",H_STDDEV,A_STDDEV,H_ENTROPY,A_ENTROPY,H_COND_ENTROPY,A_COND_ENTROPY";
+    columns += ",H2H_MEETINGS,H2H_TOTAL,H2H_MARGIN,H2H_PACE";
+    if (robust) {
+        for (const auto& column : robust_lag_columns<Schema>()) {
+            columns += "," + column;
+        }
+    }
+    return columns;
+}
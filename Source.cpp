@@ -5,126 +5,42 @@
 #include <regex>
 #include <numeric>
 #include <deque>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <cctype>
 #include "DataFrame.h"
+#include "Date.h"
+#include "GroupBy.h"
+#include "Window.h"
+#include "Parallel.h"
+#include "JobManifest.h"
+#include "ReverseLineReader.h"
+#include "LaggedAverages.h"
+#include "Correlation.h"
+#include "Describe.h"
+#include "Profiler.h"
+#include "FeatureBlock.h"
+#include "FeatureServer.h"
+#include "CombineFiles.h"
+#include "DateSort.h"
+#include "Ratings.h"
 
 namespace fs = std::filesystem;
 
-class Date {
-private:
-    int day{};
-    int month{};
-    int year{};
-    std::string date_str{};
-
-    bool is_leap(int y) const {
-        return (y % 4 == 0 && y % 100 != 0) || (y % 400 == 0);
-    }
-
-    std::tuple<int, int, int, int> split_date(const std::string& date_str) {
-        const std::regex datePattern("(\\d{2})\\.(\\d{2})\\.(\\d{4}).");
-        std::smatch matches;
-
-        if (std::regex_match(date_str, matches, datePattern)) {
-            try {
-                int day_val = std::stoi(matches[1].str());
-                int month_val = std::stoi(matches[2].str());
-                int year_val = std::stoi(matches[3].str());
-
-                return std::make_tuple(day_val, month_val, year_val, 0);
-            }
-            catch (const std::exception& e) {
-                return std::make_tuple(0, 0, 0, 1);
-            }
-        }
-        return std::make_tuple(0, 0, 0, 1);
-    }
-
-    long long to_day_number() const {
-        long long y = year - 1;
-
-        long long day_count = y * 365LL;
-        day_count += y / 4 - y / 100 + y / 400;
-
-        static const int DAYS_IN_MONTH[12] = { 31,28,31,30,31,30,31,31,30,31,30,31 };
-
-        for (int m = 1; m < month; ++m)
-            day_count += DAYS_IN_MONTH[m - 1];
-
-        if (month > 2 && is_leap(year))
-            day_count += 1;
-
-        day_count += day;
-        return day_count;
-    }
-
-    bool operator> (const Date& other) const {
-        if (year != other.year) return year > other.year;
-        if (month != other.month) return month > other.month;
-        return day > other.day;
-    }
-
-public:
-    Date() {
-        day = month = year = 0;
-        date_str = "";
-    }
-
-    void set_date(const std::string& date_str_in) {
-        this->date_str = date_str_in;
-        auto [d, m, y, err] = split_date(date_str_in);
-
-        if (err == 0) {
-            this->day = d;
-            this->month = m;
-            this->year = y;
-        }
-        else {
-            this->day = this->month = this->year = 0;
-            std::cout << "Error: Invalid date format or structure provided: " << date_str_in << std::endl;
-        }
-    }
-
-    int operator-(const Date& other) const {
-        if (!(*this > other)) return 0;
-        long long days1 = this->to_day_number();
-        long long days2 = other.to_day_number();
-        return static_cast<int>(days1 - days2);
-    }
-};
-
 void menu() {
-	std::cout << "\nUSAGE: BB_Feature_Engineering [filename.csv]\n";
-}
-
-
-int count = 0;
-
-void copy_file(const std::string& source_filename, const std::string& destination_filename) {
-    count += 1;
-    std::fstream file1{ source_filename, std::ios::in };
-    if (!file1.is_open()) {
-        std::cout << "ERROR: Couldn't open source file\n";
-        exit(1);
-    }
-    std::fstream file2{ destination_filename, std::ios::app };
-    if (!file2.is_open()) {
-        std::cout << "ERROR: Couldn't open destination file\n";
-        exit(1);
-    }
-
-    std::string line;
-    std::getline(file1, line);
-    if (count == 1) {
-        file2 << line << "\n";
-    }
-    while (std::getline(file1, line)) {
-        file2 << line << "\n";
-    }
+	std::cout << "\nUSAGE: BB_Feature_Engineering [filename.csv | jobs.manifest] [--profile] [--serve <league> <socket>]\n";
+	std::cout << "  filename.csv    prepare one season file (dates and rest days)\n";
+	std::cout << "  jobs.manifest   run every league listed in the manifest end to end\n";
+	std::cout << "  --profile       print time per stage (and allocations, in FE_PROFILE_ALLOCATIONS builds)\n";
+	std::cout << "  --serve         keep the league's team state in memory and answer feature requests\n";
+	std::cout << "                  (HEADER, FEATURES date,home,away, INGEST game, SHUTDOWN) on a Unix socket\n";
 }
 
 
-
 void modify_dates(const std::string& filename, const std::string& modified_filename) {
+	FE_PROFILE_SCOPE("modify_dates");
 	std::fstream file{ filename, std::ios::in };
 	std::fstream file2{ modified_filename, std::ios::out };
 	std::string line;
@@ -162,439 +78,90 @@ void modify_dates(const std::string& filename, const std::string& modified_filen
 	file2.close();
 }
 
-void calculate_and_insert_rest_days(const std::string& filename1, const std::string& filename2) {
-    std::vector<std::string> spreadsheet;
-    spreadsheet.reserve(1500);
-
-	//key -> BB teams, Value -> last match date
-	std::fstream file{ filename1, std::ios::in };
+// Input is newest-first, so it is walked backwards (chronologically) with a block-wise
+// reverse reader; only the per-team last match day is kept in memory. With `ratings`, the
+// same pass feeds every result to the rating engine and appends the pre-game ratings.
+void calculate_and_insert_rest_days(const std::string& filename1, const std::string& filename2, rating_engine* ratings = nullptr) {
+    FE_PROFILE_SCOPE("rest_days");
+    reverse_line_reader file{ filename1 };
 	std::fstream file2{ filename2, std::ios::out };
     if (!file.is_open() || !file2.is_open()) {
         std::cerr << "Error opening files!" << std::endl;
         return;
     }
 
-    std::unordered_map<std::string, std::string> team_dates;
-    std::string team1{}, team2{}, match_date{};
+    //team id -> day number of last match
+    category_dictionary teams;
+    std::vector<long long> team_dates;
     int home_rest_days{}, away_rest_days{};
 
-    std::ostringstream stream;
-	std::string line;
-	std::getline(file, line); //read header
-	line += std::string{ ",H_REST_DAYS,A_REST_DAYS" };
-	file2 << line << "\n";
-    while (std::getline(file, line)) {
-        spreadsheet.push_back(line);
-    }
-    spreadsheet.shrink_to_fit();
-    std::vector<std::string>::reverse_iterator r_iter = spreadsheet.rbegin();
-    while (r_iter != spreadsheet.rend()){
-        line = *r_iter;
-		std::string temp = line;
-		size_t pos = temp.find_first_of(',');
-		match_date = temp.substr(0, pos);
-		temp.erase(0, pos + 1);
-		pos = temp.find_first_of(',');
-		team1 = temp.substr(0, pos);
-		temp.erase(0, pos + 1);
-		pos = temp.find_first_of(',');
-		team2 = temp.substr(0, pos);
-
-        if (team_dates.find(team1) == team_dates.end()) {
-            home_rest_days = 50;
-            team_dates[team1] = match_date;
+    file2 << file.header() << ",H_REST_DAYS,A_REST_DAYS";
+    int home_score_field = -1, away_score_field = -1;
+    if (ratings) {
+        for (const auto& column : rating_columns()) {
+            file2 << "," << column;
         }
-        else {
-            std::string home_prev_date = std::exchange(team_dates[team1], match_date);
-            Date d1, d2;
-            d1.set_date(home_prev_date);
-            d2.set_date(match_date);
-            home_rest_days = d2 - d1;
+        std::stringstream ss(file.header());
+        std::string column;
+        for (int i = 0; std::getline(ss, column, ','); ++i) {
+            if (column == "H_SCORE") home_score_field = i;
+            if (column == "A_SCORE") away_score_field = i;
         }
-        
-        if (team_dates.find(team2) == team_dates.end()) {
-            away_rest_days = 50;
-            team_dates[team2] = match_date;
+        if (home_score_field < 3 || away_score_field < 3) {
+            throw std::runtime_error("Ratings need H_SCORE and A_SCORE columns in " + filename1);
         }
-        else {
-            std::string away_prev_date = std::exchange(team_dates[team2], match_date);
-            Date d1, d2;
-            d1.set_date(away_prev_date);
-            d2.set_date(match_date);
-            away_rest_days = d2 - d1;
-        }
-        stream << line << "," << home_rest_days << "," << away_rest_days;
-        file2 << stream.str() << "\n";
-        stream.str("");
-        r_iter++;
-	}
-    file.close();
-    file2.close();
-}
-
-double mean(const std::deque<double>& scores) {
-    if (scores.empty()) return 0;
-    int size = scores.size();
-    double result = std::accumulate(std::begin(scores), std::end(scores), 0.0) / double(size);
-    return result;
-}
-
-double standard_deviation(const std::deque<double>& scores, double mean) {
-    if (scores.size() < 2) {
-        return 0;
-    }
-    float sum_squared_diff{ 0.0 };
-    int size = scores.size();
-    for (const auto& elem : scores) {
-        sum_squared_diff += (elem - mean) * (elem - mean);
-    }
-    sum_squared_diff /= float(size - 1);
-    float stddev = std::sqrt(sum_squared_diff);
-    return stddev;
-}
-
-double skew(const std::deque<double>& scores) {
-    double avg = mean(scores);
-    size_t N = scores.size();
-    double result = 0.0;
-    for (size_t i{ 0 }; i < N; ++i) {
-        result += (scores[i] - avg) * (scores[i] - avg) * (scores[i] - avg);
-    }
-    result /= (double)N;
-    double var = std::pow(standard_deviation(scores, avg), 2);
-    var = std::pow(var, 1.5);
-    if (var < 1e-9) return 0.0;
-    result /= var;
-    return result;
-}
-
-double kurtosis(const std::deque<double>& scores) {
-    double avg = mean(scores);
-    size_t N = scores.size();
-
-    if (N < 4) return 0.0;
-
-    double result = 0.0;
-
-    for (size_t i = 0; i < N; ++i) {
-        double diff = scores[i] - avg;
-        result += diff * diff * diff * diff;
-    }
-    result /= (double)N;
-
-    double var = std::pow(standard_deviation(scores, avg), 2);
-    if (var < 1e-9) return 0.0;
-
-    result /= (var * var); // divide by σ^4
-    result -= 3.0;         // excess kurtosis (normal → 0)
-
-    return result;
-}
-
-
-auto exponential_smoothing(const std::deque<double>& vec, double alpha) -> double {
-    if (vec.size() == 0) return 0;
-    if (vec.size() < 2) return vec[0];
-
-    int N = vec.size();
-    int k = N/2;
-    double smoothed = mean(std::deque<double>(vec.begin(), vec.begin() + k));
-    
-    for (size_t i = 1; i < vec.size(); ++i) {
-        smoothed = alpha * vec[i] + (1 - alpha) * smoothed;
-    }
-    return smoothed;
-}
-
-float predict_next_score(const std::deque<double>& scores) {
-    return 0.5 * mean(scores) + 0.5 * exponential_smoothing(scores, 0.25);
-}
-
-std::unordered_map<char, int> range_bin(const std::deque<double>& series) {
-    std::unordered_map<char, int> result;
-    result['s'] = 0;
-    result['g'] = 0;
-    result['l'] = 0;
-    const double avg = mean(series);
-    const double stddev = standard_deviation(series, avg);
-
-    for (auto elem : series) {
-        if (elem  < (avg - stddev))
-            result['l']++;
-        else if (elem > (avg + stddev))
-            result['g']++;
-        else 
-            result['s']++;
-    }
-    return result;
-}
-
-std::vector<double> probabilities(const std::unordered_map<char, int>& dict) {
-    int total = 0;
-    std::vector<double> probs;
-    for (const auto& [k, v] : dict) {
-        probs.push_back(v);
-        total += v;
     }
-    std::for_each(std::begin(probs), std::end(probs), [total](double& prob) {
-        prob /= (double)total;
-    });
-    return probs;
-}
-
-double entropy(const std::vector<double>& probabilities) {
-    double result = 0.0;
-    for (auto pi : probabilities) {
-        if (pi > 0)
-            result += pi * std::log2(pi);
-    }
-    result *= -1;
-    return result;
-}
-
-double conditional_entropy(const std::deque<double>& series) {
-    std::unordered_map<int, int> joint;
-    std::unordered_map<int, int> prev;
-    int N = series.size();
-    for (int i = 1; i < N; ++i) {
-        int key = series[i - 1] * 1000 + series[i];
-        joint[key]++;
-        prev[series[i - 1]]++;
-    }
-    double H = 0.0;
-    for (auto& kv : joint) {
-        int prev_state = kv.first / 1000;
-        double p_xy = (double)kv.second / (N - 1);
-        double p_x = (double)prev[prev_state] / (N - 1);
-        H -= p_xy * std::log2(p_xy / p_x);
-    }
-    return H;
-}
-
-void calculate_and_create_lagged_averages(const std::string& filename1, const std::string& filename2, int window_size = 5) {
-    std::fstream file{ filename1, std::ios::in };
-    std::fstream file2{ filename2, std::ios::out };
-    if (!file.is_open() || !file2.is_open()) {
-        std::cerr << "Error opening files!" << std::endl;
-        return;
-    }
-    struct TeamTotals {
-        std::deque<double> home_values;
-        std::deque<double> away_values;
-    };
-
-    std::vector<std::unordered_map<std::string, TeamTotals>> lagged_features_average(27);
-
-    std::vector<std::string> first_three_features(3);
-    std::vector<std::string> last_three_features(3);
-
-    std::ostringstream stream;
-    std::string header, line;
-    std::getline(file, header); //read header
-
-    //file2 << header << R"(,H_FG%_ALLOWED,A_FG%_ALLOWED,H_2FG%_ALLOWED,A_2FG%_ALLOWED,H_3FG%_ALLOWED,A_3FG%_ALLOWED,H_TOV_ALLOWED,A_TOV_ALLOWED,H_ENTROPY,A_ENTROPY,H_COND_ENTROPY,A_COND_ENTROPY,H_SKEW,A_SKEW,H_KURTOSIS,A_KURTOSIS)";
-    //file2 << header << R"(,H_FG%_ALLOWED,A_FG%_ALLOWED,H_2FG%_ALLOWED,A_2FG%_ALLOWED,H_3FG%_ALLOWED,A_3FG%_ALLOWED,H_TOV_ALLOWED,A_TOV_ALLOWED)";
-    file2 << header << R"(,H_FG%_ALLOWED,A_FG%_ALLOWED,H_2FG%_ALLOWED,A_2FG%_ALLOWED,H_3FG%_ALLOWED,A_3FG%_ALLOWED,H_TOV_ALLOWED,A_TOV_ALLOWED,H_STDDEV,A_STDDEV)";
-
     file2 << "\n";
-    while (std::getline(file, line)) {
-        size_t pos;
-        int i;
-        for (i = 0; i < 3; ++i) {
-            pos = line.find_first_of(',');
-            first_three_features[i] = line.substr(0, pos);
-            line.erase(0, pos + 1);
-        }
-        std::string feature{};
-        double home_fg_pct{ 0.0 }, away_fg_pct{ 0.0 };
-        double home_2fg_pct{ 0.0 }, away_2fg_pct{ 0.0 };
-        double home_3fg_pct{ 0.0 }, away_3fg_pct{ 0.0 };
-        double home_tov{ 0.0 }, away_tov{ 0.0 };
-
-        std::string h_team = first_three_features[1];
-        std::string a_team = first_three_features[2];
-
-        
-
-        for (i = 0; i < 23; ++i) {
-            pos = line.find_first_of(',');
-            feature = line.substr(0, pos);
-            lagged_features_average[i][h_team].home_values.push_back(std::stod(feature));
-            line.erase(0, pos + 1);
-            if (i == 3)
-                home_fg_pct = std::stod(feature);
-            else if (i == 6)
-                home_2fg_pct = std::stod(feature);
-            else if (i == 9)
-                home_3fg_pct = std::stod(feature);
-            else if (i == 18)
-                home_tov = std::stod(feature);
-
-
-            pos = line.find_first_of(',');
-            feature = line.substr(0, pos);
-            lagged_features_average[i][a_team].away_values.push_back(std::stod(feature));
-            line.erase(0, pos + 1);
-            if (i == 3)
-                away_fg_pct = std::stod(feature);
-            else if (i == 6)
-                away_2fg_pct = std::stod(feature);
-            else if (i == 9)
-                away_3fg_pct = std::stod(feature);
-            else if (i == 18)
-                away_tov = std::stod(feature);
-        }
 
-        lagged_features_average[i][h_team].home_values.push_back(away_fg_pct);
-        lagged_features_average[i][a_team].away_values.push_back(home_fg_pct);
-        ++i;
-        lagged_features_average[i][h_team].home_values.push_back(away_2fg_pct);
-        lagged_features_average[i][a_team].away_values.push_back(home_2fg_pct);
-        ++i;
-        lagged_features_average[i][h_team].home_values.push_back(away_3fg_pct);
-        lagged_features_average[i][a_team].away_values.push_back(home_3fg_pct);
-        ++i;
-        lagged_features_average[i][h_team].home_values.push_back(away_tov);
-        lagged_features_average[i][a_team].away_values.push_back(home_tov);
-
-        
-        for (i = 0; i < 2; ++i) {
-            pos = line.find_first_of(',');
-            last_three_features[i] = line.substr(0, pos);
-            line.erase(0, pos + 1);
+    auto field = [](std::string_view& rest) {
+        size_t pos = rest.find(',');
+        std::string_view value = rest.substr(0, pos);
+        rest.remove_prefix(pos == std::string_view::npos ? rest.size() : pos + 1);
+        return value;
+    };
+    auto rest_days = [&](std::string_view name, long long match_day, std::string_view match_date) {
+        std::uint32_t team = teams.encode(name);
+        if (team == team_dates.size()) {
+            team_dates.push_back(match_day);
+            return 50;
         }
-        last_three_features[2] = line;
-
-
-        if (lagged_features_average[0][h_team].home_values.size() > (window_size + 1)) {
-            for (i = 0; i < lagged_features_average.size(); ++i) {
-                lagged_features_average[i][h_team].home_values.pop_front();
-            }
-        }
-        if (lagged_features_average[0][a_team].away_values.size() > (window_size + 1)) {
-            for (i = 0; i < lagged_features_average.size(); ++i) {
-                lagged_features_average[i][a_team].away_values.pop_front();
-            }
+        long long previous = std::exchange(team_dates[team], match_day);
+        if (match_day < 0 || previous < 0) {
+            std::cout << "Error: Invalid date format or structure provided: " << match_date << std::endl;
+            return 0;
         }
+        return match_day > previous ? static_cast<int>(match_day - previous) : 0;
+    };
 
-        if (lagged_features_average[0][h_team].home_values.size() == (window_size+1) && lagged_features_average[0][a_team].away_values.size() == (window_size+1)) {
-            for (const auto& elem : first_three_features) {
-                stream << elem << ",";
+    std::string_view line;
+    while (file.next(line)) {
+        std::string_view rest = line;
+        std::string_view match_date = field(rest);
+        std::string_view team1 = field(rest);
+        std::string_view team2 = field(rest);
+        long long match_day = day_number(match_date);
+
+        home_rest_days = rest_days(team1, match_day, match_date);
+        away_rest_days = rest_days(team2, match_day, match_date);
+        file2 << line << "," << home_rest_days << "," << away_rest_days;
+        if (ratings) {
+            double home_score = 0, away_score = 0;
+            bool scores_valid = true;
+            for (int i = 3; i <= std::max(home_score_field, away_score_field); ++i) {
+                std::string_view value = field(rest);
+                if (i == home_score_field) scores_valid = parse_double(value, home_score) && scores_valid;
+                if (i == away_score_field) scores_valid = parse_double(value, away_score) && scores_valid;
             }
-            for (i = 0; i < 23; ++i) {
-                std::deque<double> home_home_values(
-                    lagged_features_average[i][h_team].home_values.begin(),
-                    std::prev(lagged_features_average[i][h_team].home_values.end())
-                );
-                std::deque<double> home_away_values(
-                    lagged_features_average[i][h_team].away_values.begin(),
-                    std::prev(lagged_features_average[i][h_team].away_values.end())
-                );
-                std::deque<double> away_home_values(
-                    lagged_features_average[i][a_team].home_values.begin(),
-                    std::prev(lagged_features_average[i][a_team].home_values.end())
-                );
-                std::deque<double> away_away_values (
-                    lagged_features_average[i][a_team].away_values.begin(),
-                    std::prev(lagged_features_average[i][a_team].away_values.end())
-                );
-
-                double avg1 = predict_next_score(home_home_values) * 0.6 +
-                    predict_next_score(home_away_values) * 0.4; //NBA
-                double avg2 = predict_next_score(away_away_values) * 0.6 +
-                    predict_next_score(away_home_values) * 0.4;
-
-                stream << avg1 << "," << avg2 << ",";
+            if (!scores_valid) {
+                throw std::runtime_error("Ratings: invalid score in row " + std::string(line));
             }
-            
-            stream << last_three_features[0] << "," << last_three_features[1] << "," << last_three_features[2] << ",";
-
-         
-            for (; i < 27; ++i) {
-                std::deque<double> home_home_values(
-                    lagged_features_average[i][h_team].home_values.begin(),
-                    std::prev(lagged_features_average[i][h_team].home_values.end())
-                );
-                std::deque<double> home_away_values(
-                    lagged_features_average[i][h_team].away_values.begin(),
-                    std::prev(lagged_features_average[i][h_team].away_values.end())
-                );
-
-                std::deque<double> away_home_values(
-                    lagged_features_average[i][a_team].home_values.begin(),
-                    std::prev(lagged_features_average[i][a_team].home_values.end())
-                );
-                std::deque<double> away_away_values(
-                    lagged_features_average[i][a_team].away_values.begin(),
-                    std::prev(lagged_features_average[i][a_team].away_values.end())
-                );
-
-                double avg1 = predict_next_score(home_home_values) * 0.6 +
-                    predict_next_score(home_away_values) * 0.4; //NBA
-                double avg2 = predict_next_score(away_away_values) * 0.6 +
-                    predict_next_score(away_home_values) * 0.4;
-
-                stream << avg1 << "," << avg2<<",";
-
-                //stream << avg1 << "," << avg2;
-                //if (i < 26) stream << ",";
+            game_ratings pre_game = ratings->update(match_date, team1, team2, home_score, away_score);
+            for (double value : pre_game.values) {
+                file2 << "," << value;
             }
-
-            double home_stddev = 0, away_stddev = 0;
-            std::deque<double> h_v{ 
-                lagged_features_average[0][h_team].home_values.begin(),
-                    std::prev(lagged_features_average[0][h_team].home_values.end()) };
-            std::deque<double> a_v{
-                    lagged_features_average[0][a_team].away_values.begin(),
-                    std::prev(lagged_features_average[0][a_team].away_values.end()) };
-
-            for (auto elem : lagged_features_average[0][h_team].away_values)
-                h_v.push_back(elem);
-
-            for (auto elem : lagged_features_average[0][a_team].home_values)
-                a_v.push_back(elem);
-
-            home_stddev = standard_deviation(h_v, mean(h_v));
-            away_stddev = standard_deviation(a_v, mean(a_v));
-
-            //double home_entropy = entropy(probabilities(range_bin(h_v)));
-            //double away_entropy = entropy(probabilities(range_bin(a_v)));
-            //double home_cond_entropy = conditional_entropy(h_v);
-            //double away_cond_entropy = conditional_entropy(a_v);
-            //double home_skew = skew(h_v);
-            //double away_skew = skew(a_v);
-            //double home_kurt = kurtosis(h_v);
-            //double away_kurt = kurtosis(a_v);
-                
-
-            //stream << home_entropy << "," << away_entropy <<",";
-            //stream << home_cond_entropy << "," << away_cond_entropy <<",";
-            //stream << home_skew << "," << away_skew <<",";
-            //stream << home_kurt << "," << away_kurt;*/
-
-            stream << home_stddev << "," << away_stddev;
-
-            line = stream.str() + "\n";
-            file2 << line;
-            stream.str("");
-            line.clear();
         }
-    }
-
-    std::string team = "Dallas Mavericks";
-    std::cout << "got here\n";
-    std::deque<double> home_values = lagged_features_average[0][team].home_values;
-    std::deque<double> away_values = lagged_features_average[0][team].away_values;
-    std::cout << "size 1 = " << home_values.size() << "\n";
-    std::cout << "size 2 = " << away_values.size() << "\n";
-    for (double i : home_values) {
-        std::cout << i << " ";
-    }
-    std::cout << "\n\n";
-    for (int i : away_values) {
-        std::cout << i << " ";
-    }
-    file.close();
+        file2 << "\n";
+	}
     file2.close();
 }
 
@@ -611,156 +178,123 @@ std::string get_modified_filePath(const std::string& originalPath, const std::st
     }
 }
 
-int main(int argc, char* argv[]) {
-	if (argc != 2) {
-		menu();
-		exit(1);
-	}
-	std::string filename = std::string(argv[1]);
-
-	std::string modified_filename_1 = get_modified_filePath(filename, "_modified_date");
-	modify_dates(filename, modified_filename_1);
-	std::string modified_filename_2 = get_modified_filePath(filename, "_reversed_plus_rest_days");
-	calculate_and_insert_rest_days(modified_filename_1, modified_filename_2);
-
-   std::vector<std::string> files{
-        R"(C:\Users\HP\source\repos\Rehoboam\Rehoboam\Data\Basketball\nba\2019-2020_reversed_plus_rest_days.csv)",
-        R"(C:\Users\HP\source\repos\Rehoboam\Rehoboam\Data\Basketball\nba\2020-2021_reversed_plus_rest_days.csv)",
-        R"(C:\Users\HP\source\repos\Rehoboam\Rehoboam\Data\Basketball\nba\2021-2022_reversed_plus_rest_days.csv)",
-        R"(C:\Users\HP\source\repos\Rehoboam\Rehoboam\Data\Basketball\nba\2022-2023_reversed_plus_rest_days.csv)",
-        R"(C:\Users\HP\source\repos\Rehoboam\Rehoboam\Data\Basketball\nba\2023-2024_reversed_plus_rest_days.csv)",
-        R"(C:\Users\HP\source\repos\Rehoboam\Rehoboam\Data\Basketball\nba\2024-2025_reversed_plus_rest_days.csv)",
-        R"(C:\Users\HP\source\repos\Rehoboam\Rehoboam\Data\Basketball\nba\2025-2026_reversed_plus_rest_days.csv)"
-    };
-
-   /*std::vector<std::string> files{
-        R"(C:\Users\HP\source\repos\Rehoboam\Rehoboam\Data\Basketball\b-league\2023-2024_reversed_plus_rest_days.csv)",
-        R"(C:\Users\HP\source\repos\Rehoboam\Rehoboam\Data\Basketball\b-league\2024-2025_reversed_plus_rest_days.csv)",
-        R"(C:\Users\HP\source\repos\Rehoboam\Rehoboam\Data\Basketball\b-league\2025-2026_reversed_plus_rest_days.csv)"
-    };*/
-
-    std::string combinedFile{ fs::path(files[0]).parent_path().string() + R"(\combined.csv)" };
-    for (const auto& filename : files) {
-        copy_file(filename, combinedFile);
-    }
-
-    std::string modified_filename_3 = get_modified_filePath(combinedFile, "_lagged_averages");
-
-    //calculate_and_create_lagged_averages(combinedFile, modified_filename_3, 4);
-    //calculate_and_create_lagged_averages(combinedFile, modified_filename_3, 5);
-    //calculate_and_create_lagged_averages(combinedFile, modified_filename_3, 6);
-    //calculate_and_create_lagged_averages(combinedFile, modified_filename_3, 7);
-    //calculate_and_create_lagged_averages(combinedFile, modified_filename_3, 8);
-    //calculate_and_create_lagged_averages(combinedFile, modified_filename_3, 9); 
-    calculate_and_create_lagged_averages(combinedFile, modified_filename_3, 10); 
-    //calculate_and_create_lagged_averages(combinedFile, modified_filename_3, 11); 
-    //calculate_and_create_lagged_averages(combinedFile, modified_filename_3, 12);
-    //calculate_and_create_lagged_averages(combinedFile, modified_filename_3, 13);
-    //calculate_and_create_lagged_averages(combinedFile, modified_filename_3, 15);
-
-    dataframe basketball_data = load_data(modified_filename_3);
-
-    basketball_data["H_2FG_RATE"] = basketball_data["H_2FGA"] / basketball_data["H_FGA"];
-    basketball_data["A_2FG_RATE"] = basketball_data["A_2FGA"] / basketball_data["A_FGA"];
-    basketball_data["H_3FG_RATE"] = basketball_data["H_3FGA"] / basketball_data["H_FGA"];
-    basketball_data["A_3FG_RATE"] = basketball_data["A_3FGA"] / basketball_data["A_FGA"];
-    basketball_data["H_FT_RATE"] = basketball_data["H_FTA"] / basketball_data["H_FGA"];
-    basketball_data["A_FT_RATE"] = basketball_data["A_FTA"] / basketball_data["A_FGA"];
-    basketball_data["H_TOV_RATE"] = basketball_data["H_TOV"] / (basketball_data["H_FGA"] + basketball_data["H_FTA"] * 0.44 + basketball_data["H_TOV"]);
-    basketball_data["A_TOV_RATE"] = basketball_data["A_TOV"] / (basketball_data["A_FGA"] + basketball_data["A_FTA"] * 0.44 + basketball_data["A_TOV"]);
-    basketball_data["H_OREB_RATE"] = basketball_data["H_OREB"] / (basketball_data["H_OREB"] + basketball_data["A_DREB"]);
-    basketball_data["A_OREB_RATE"] = basketball_data["A_OREB"] / (basketball_data["A_OREB"] + basketball_data["H_DREB"]);
-    basketball_data["H_DREB_RATE"] = basketball_data["H_DREB"] / (basketball_data["H_DREB"] + basketball_data["A_OREB"]);
-    basketball_data["A_DREB_RATE"] = basketball_data["A_DREB"] / (basketball_data["A_DREB"] + basketball_data["H_OREB"]);
+// Row-wise derived features: rates, possessions, TS%, matchup differences and binary flags.
+feature_block derived_feature_block() {
+    feature_block f;
+    const int h_score = f.input("H_SCORE"), a_score = f.input("A_SCORE");
+    const int h_fga = f.input("H_FGA"), a_fga = f.input("A_FGA");
+    const int h_fg = f.input("H_FG"), a_fg = f.input("A_FG");
+    const int h_2fga = f.input("H_2FGA"), a_2fga = f.input("A_2FGA");
+    const int h_3fga = f.input("H_3FGA"), a_3fga = f.input("A_3FGA");
+    const int h_3fg = f.input("H_3FG"), a_3fg = f.input("A_3FG");
+    const int h_fta = f.input("H_FTA"), a_fta = f.input("A_FTA");
+    const int h_oreb = f.input("H_OREB"), a_oreb = f.input("A_OREB");
+    const int h_dreb = f.input("H_DREB"), a_dreb = f.input("A_DREB");
+    const int h_tov = f.input("H_TOV"), a_tov = f.input("A_TOV");
+    const int h_off = f.input("H_OFF_RATING"), a_off = f.input("A_OFF_RATING");
+    const int h_def = f.input("H_DEF_RATING"), a_def = f.input("A_DEF_RATING");
+    const int h_fg_pct = f.input("H_FG%"), a_fg_pct = f.input("A_FG%");
+    const int h_2fg_pct = f.input("H_2FG%"), a_2fg_pct = f.input("A_2FG%");
+    const int h_3fg_pct = f.input("H_3FG%"), a_3fg_pct = f.input("A_3FG%");
+    const int h_fg_allowed = f.input("H_FG%_ALLOWED"), a_fg_allowed = f.input("A_FG%_ALLOWED");
+    const int h_2fg_allowed = f.input("H_2FG%_ALLOWED"), a_2fg_allowed = f.input("A_2FG%_ALLOWED");
+    const int h_3fg_allowed = f.input("H_3FG%_ALLOWED"), a_3fg_allowed = f.input("A_3FG%_ALLOWED");
+    const int h_rest = f.input("H_REST_DAYS"), a_rest = f.input("A_REST_DAYS");
+    const int h_stddev = f.input("H_STDDEV"), a_stddev = f.input("A_STDDEV");
+
+    f.define("H_2FG_RATE", [=](const feature_row& r) { return ratio(r[h_2fga], r[h_fga]); });
+    f.define("A_2FG_RATE", [=](const feature_row& r) { return ratio(r[a_2fga], r[a_fga]); });
+    const int h_3fg_rate = f.define("H_3FG_RATE", [=](const feature_row& r) { return ratio(r[h_3fga], r[h_fga]); });
+    const int a_3fg_rate = f.define("A_3FG_RATE", [=](const feature_row& r) { return ratio(r[a_3fga], r[a_fga]); });
+    f.define("H_FT_RATE", [=](const feature_row& r) { return ratio(r[h_fta], r[h_fga]); });
+    f.define("A_FT_RATE", [=](const feature_row& r) { return ratio(r[a_fta], r[a_fga]); });
+    f.define("H_TOV_RATE", [=](const feature_row& r) { return ratio(r[h_tov], r[h_fga] + r[h_fta] * 0.44 + r[h_tov]); });
+    f.define("A_TOV_RATE", [=](const feature_row& r) { return ratio(r[a_tov], r[a_fga] + r[a_fta] * 0.44 + r[a_tov]); });
+    f.define("H_OREB_RATE", [=](const feature_row& r) { return ratio(r[h_oreb], r[h_oreb] + r[a_dreb]); });
+    f.define("A_OREB_RATE", [=](const feature_row& r) { return ratio(r[a_oreb], r[a_oreb] + r[h_dreb]); });
+    f.define("H_DREB_RATE", [=](const feature_row& r) { return ratio(r[h_dreb], r[h_dreb] + r[a_oreb]); });
+    f.define("A_DREB_RATE", [=](const feature_row& r) { return ratio(r[a_dreb], r[a_dreb] + r[h_oreb]); });
 
     // Effective Field Goal Percentage(accounts for 3PT value)
-    basketball_data["H_EFG%"] = (basketball_data["H_FG"] + (basketball_data["H_3FG"] * 0.5)) / basketball_data["H_FGA"];
-    basketball_data["A_EFG%"] = (basketball_data["A_FG"] + (basketball_data["A_3FG"] * 0.5)) / basketball_data["A_FGA"];
+    const int h_efg = f.define("H_EFG%", [=](const feature_row& r) { return ratio(r[h_fg] + r[h_3fg] * 0.5, r[h_fga]); });
+    const int a_efg = f.define("A_EFG%", [=](const feature_row& r) { return ratio(r[a_fg] + r[a_3fg] * 0.5, r[a_fga]); });
 
     // Pace(possessions estimate)
-    basketball_data["H_POSS"] = basketball_data["H_FGA"] + (basketball_data["H_FTA"] * 0.44) - basketball_data["H_OREB"] + basketball_data["H_TOV"];
-    basketball_data["A_POSS"] = basketball_data["A_FGA"] + (basketball_data["A_FTA"] * 0.44) - basketball_data["A_OREB"] + basketball_data["A_TOV"];
-    basketball_data["GAME_PACE"] = (basketball_data["H_POSS"] + basketball_data["A_POSS"]) * 0.5;
+    const int h_poss = f.define("H_POSS", [=](const feature_row& r) { return r[h_fga] + r[h_fta] * 0.44 - r[h_oreb] + r[h_tov]; });
+    const int a_poss = f.define("A_POSS", [=](const feature_row& r) { return r[a_fga] + r[a_fta] * 0.44 - r[a_oreb] + r[a_tov]; });
+    const int pace = f.define("GAME_PACE", [=](const feature_row& r) { return (r[h_poss] + r[a_poss]) * 0.5; });
 
     // Points Per Possession
-    basketball_data["H_PPP"] = basketball_data["H_SCORE"] / basketball_data["H_POSS"];
-    basketball_data["A_PPP"] = basketball_data["A_SCORE"] / basketball_data["A_POSS"];
+    f.define("H_PPP", [=](const feature_row& r) { return ratio(r[h_score], r[h_poss]); });
+    f.define("A_PPP", [=](const feature_row& r) { return ratio(r[a_score], r[a_poss]); });
 
     // TS% 
-    basketball_data["H_TS%"] = basketball_data["H_SCORE"] / ((basketball_data["H_FGA"] + basketball_data["H_FTA"] * 0.44) * 2.0);
-    basketball_data["A_TS%"] = basketball_data["A_SCORE"] / ((basketball_data["A_FGA"] + basketball_data["A_FTA"] * 0.44) * 2.0);
-    basketball_data["AVG_TS%"] = (basketball_data["H_TS%"] + basketball_data["A_TS%"]) * 0.5;
-
+    const int h_ts = f.define("H_TS%", [=](const feature_row& r) { return ratio(r[h_score], (r[h_fga] + r[h_fta] * 0.44) * 2.0); });
+    const int a_ts = f.define("A_TS%", [=](const feature_row& r) { return ratio(r[a_score], (r[a_fga] + r[a_fta] * 0.44) * 2.0); });
+    const int avg_ts = f.define("AVG_TS%", [=](const feature_row& r) { return (r[h_ts] + r[a_ts]) * 0.5; });
 
     ////Matchup stats
-    basketball_data["H_OFF_VS_A_DEF"] = basketball_data["H_OFF_RATING"] - basketball_data["A_DEF_RATING"];
-    basketball_data["A_OFF_VS_H_DEF"] = basketball_data["A_OFF_RATING"] - basketball_data["H_DEF_RATING"];
-    basketball_data["H_FG%_VS_A_ALLOWED"] = basketball_data["H_FG%"] - basketball_data["A_FG%_ALLOWED"];
-    basketball_data["A_FG%_VS_H_ALLOWED"] = basketball_data["A_FG%"] - basketball_data["H_FG%_ALLOWED"];
-    basketball_data["H_2FG%_VS_A_ALLOWED"] = basketball_data["H_2FG%"] - basketball_data["A_2FG%_ALLOWED"];
-    basketball_data["A_2FG%_VS_H_ALLOWED"] = basketball_data["A_2FG%"] - basketball_data["H_2FG%_ALLOWED"];
-    basketball_data["H_3FG%_VS_A_ALLOWED"] = basketball_data["H_3FG%"] - basketball_data["A_3FG%_ALLOWED"];
-    basketball_data["A_3FG%_VS_H_ALLOWED"] = basketball_data["A_3FG%"] - basketball_data["H_3FG%_ALLOWED"];
+    f.define("H_OFF_VS_A_DEF", [=](const feature_row& r) { return r[h_off] - r[a_def]; });
+    f.define("A_OFF_VS_H_DEF", [=](const feature_row& r) { return r[a_off] - r[h_def]; });
+    f.define("H_FG%_VS_A_ALLOWED", [=](const feature_row& r) { return r[h_fg_pct] - r[a_fg_allowed]; });
+    f.define("A_FG%_VS_H_ALLOWED", [=](const feature_row& r) { return r[a_fg_pct] - r[h_fg_allowed]; });
+    f.define("H_2FG%_VS_A_ALLOWED", [=](const feature_row& r) { return r[h_2fg_pct] - r[a_2fg_allowed]; });
+    f.define("A_2FG%_VS_H_ALLOWED", [=](const feature_row& r) { return r[a_2fg_pct] - r[h_2fg_allowed]; });
+    f.define("H_3FG%_VS_A_ALLOWED", [=](const feature_row& r) { return r[h_3fg_pct] - r[a_3fg_allowed]; });
+    f.define("A_3FG%_VS_H_ALLOWED", [=](const feature_row& r) { return r[a_3fg_pct] - r[h_3fg_allowed]; });
 
     // Expected score based on matchup
-    basketball_data["H_EXPECTED_SCORE"] =
-        ((basketball_data["H_OFF_RATING"] + basketball_data["A_DEF_RATING"]) * 0.5) *
-        (basketball_data["H_POSS"] / 100.0);
-    basketball_data["A_EXPECTED_SCORE"] =
-        ((basketball_data["A_OFF_RATING"] + basketball_data["H_DEF_RATING"]) * 0.5) *
-        (basketball_data["A_POSS"] / 100.0);
+    const int h_expected = f.define("H_EXPECTED_SCORE", [=](const feature_row& r) { return ((r[h_off] + r[a_def]) * 0.5) * (r[h_poss] / 100.0); });
+    const int a_expected = f.define("A_EXPECTED_SCORE", [=](const feature_row& r) { return ((r[a_off] + r[h_def]) * 0.5) * (r[a_poss] / 100.0); });
 
     // Make EXPECTED_TOTAL consistent - just sum the individual scores
-    basketball_data["EXPECTED_TOTAL"] =
-        basketball_data["H_EXPECTED_SCORE"] + basketball_data["A_EXPECTED_SCORE"];
+    f.define("EXPECTED_TOTAL", [=](const feature_row& r) { return r[h_expected] + r[a_expected]; });
 
     // Net ratings
-    basketball_data["H_NET_RATING"] = basketball_data["H_OFF_RATING"] - basketball_data["H_DEF_RATING"];
-    basketball_data["A_NET_RATING"] = basketball_data["A_OFF_RATING"] - basketball_data["A_DEF_RATING"];
-    basketball_data["NET_RATING_DIFF"] = basketball_data["H_NET_RATING"] - basketball_data["A_NET_RATING"];
+    const int h_net = f.define("H_NET_RATING", [=](const feature_row& r) { return r[h_off] - r[h_def]; });
+    const int a_net = f.define("A_NET_RATING", [=](const feature_row& r) { return r[a_off] - r[a_def]; });
+    const int net_diff = f.define("NET_RATING_DIFF", [=](const feature_row& r) { return r[h_net] - r[a_net]; });
 
     // More advanced metrics
-    basketball_data["REST_DIFF"] = basketball_data["H_REST_DAYS"] - basketball_data["A_REST_DAYS"];
-    basketball_data["PACE_X_NET_RATING"] = basketball_data["GAME_PACE"] * basketball_data["NET_RATING_DIFF"];
-    //basketball_data["PACE_X_EFFICIENCY"] = basketball_data["GAME_PACE"] * basketball_data["AVG_TS%"];
-    basketball_data["PACE_X_EFFICIENCY"] =
-        (basketball_data["GAME_PACE"] / 100.0) * basketball_data["AVG_TS%"] * 200.0;
+    f.define("REST_DIFF", [=](const feature_row& r) { return r[h_rest] - r[a_rest]; });
+    f.define("PACE_X_NET_RATING", [=](const feature_row& r) { return r[pace] * r[net_diff]; });
+    f.define("PACE_X_EFFICIENCY", [=](const feature_row& r) { return (r[pace] / 100.0) * r[avg_ts] * 200.0; });
 
     //Numeric binary flags
-    basketball_data["FAST_PACE"] = (basketball_data["GAME_PACE"] > 102.0);
-    basketball_data["BOTH_EFFICIENT"] =
-        ((basketball_data["H_EFG%"] > 0.54) && (basketball_data["A_EFG%"] > 0.54));
-    basketball_data["STRONG_DEFENSE"] =
-        ((basketball_data["H_DEF_RATING"] < 108) && (basketball_data["A_DEF_RATING"] < 108));
-
-    basketball_data["HIGH_SCORING_SETUP"] =
-        ((basketball_data["GAME_PACE"] > 100.0) && (basketball_data["AVG_TS%"] > 0.55));
-
-    basketball_data["LOW_SCORING_SETUP"] =
-        ((basketball_data["GAME_PACE"] < 96.0) ||
-            ((basketball_data["H_DEF_RATING"] < 108) && (basketball_data["A_DEF_RATING"] < 108)));
-
-    basketball_data["TOTAL_OFF_STRENGTH"] =
-        (basketball_data["H_OFF_RATING"] + basketball_data["A_OFF_RATING"]) *
-        (basketball_data["GAME_PACE"] / 100.0);
-
-    basketball_data["TOTAL_DEF_STRENGTH"] =
-        (basketball_data["H_DEF_RATING"] + basketball_data["A_DEF_RATING"]) *
-        (basketball_data["GAME_PACE"] / 100.0);
-
-    basketball_data["PACE_SQUARED"] =
-        basketball_data["GAME_PACE"] * basketball_data["GAME_PACE"];
+    f.define("FAST_PACE", [=](const feature_row& r) { return flag_greater(r[pace], 102.0); });
+    f.define("BOTH_EFFICIENT", [=](const feature_row& r) { return flag_and(flag_greater(r[h_efg], 0.54), flag_greater(r[a_efg], 0.54)); });
+    f.define("STRONG_DEFENSE", [=](const feature_row& r) { return flag_and(flag_less(r[h_def], 108), flag_less(r[a_def], 108)); });
+    f.define("HIGH_SCORING_SETUP", [=](const feature_row& r) { return flag_and(flag_greater(r[pace], 100.0), flag_greater(r[avg_ts], 0.55)); });
+    f.define("LOW_SCORING_SETUP", [=](const feature_row& r) {
+        return flag_or(flag_less(r[pace], 96.0), flag_and(flag_less(r[h_def], 108), flag_less(r[a_def], 108)));
+    });
 
-    basketball_data["AVG_3FG_RATE"] =
-        (basketball_data["H_3FG_RATE"] + basketball_data["A_3FG_RATE"]) * 0.5;
+    f.define("TOTAL_OFF_STRENGTH", [=](const feature_row& r) { return (r[h_off] + r[a_off]) * (r[pace] / 100.0); });
+    f.define("TOTAL_DEF_STRENGTH", [=](const feature_row& r) { return (r[h_def] + r[a_def]) * (r[pace] / 100.0); });
+    f.define("PACE_SQUARED", [=](const feature_row& r) { return r[pace] * r[pace]; });
+    f.define("AVG_3FG_RATE", [=](const feature_row& r) { return (r[h_3fg_rate] + r[a_3fg_rate]) * 0.5; });
+    f.define("EFFICIENCY_GAP", [=](const feature_row& r) { return std::abs(r[h_efg] - r[a_efg]); });
+    f.define("EXPECTED_STDDEV", [=](const feature_row& r) { return std::sqrt(r[h_stddev] * r[h_stddev] + r[a_stddev] * r[a_stddev]); });
+    return f;
+}
 
-    basketball_data["EFFICIENCY_GAP"] =
-        apply_function(basketball_data["H_EFG%"] - basketball_data["A_EFG%"], std::abs);
+// Team history of game totals: home team's home games, away team's away games, pre-game only.
+constexpr double TOTAL_EWM_ALPHA = 0.25;
+constexpr size_t TOTAL_STD_WINDOW = 5;
 
-    basketball_data["EXPECTED_STDDEV"] = apply_function((basketball_data["H_STDDEV"] *
-        basketball_data["H_STDDEV"]) + (basketball_data["A_STDDEV"] * basketball_data["A_STDDEV"]), std::sqrt);
+void add_derived_features(dataframe& basketball_data) {
+    FE_PROFILE_SCOPE("derived_features");
+    derived_feature_block().evaluate(basketball_data);
 
+    basketball_data["H_TOTAL_EWM"] = ewm(basketball_data, "TOTAL", { "HOME", "DATE", true }, TOTAL_EWM_ALPHA);
+    basketball_data["A_TOTAL_EWM"] = ewm(basketball_data, "TOTAL", { "AWAY", "DATE", true }, TOTAL_EWM_ALPHA);
+    basketball_data["H_TOTAL_STD"] = rolling_std(basketball_data, "TOTAL", { "HOME", "DATE", true }, TOTAL_STD_WINDOW);
+    basketball_data["A_TOTAL_STD"] = rolling_std(basketball_data, "TOTAL", { "AWAY", "DATE", true }, TOTAL_STD_WINDOW);
+}
 
+// Columns of the feature file; ratings and robust lag outputs, when the job writes them, go
+// before TOTAL.
+std::vector<std::string> output_features(bool robust_lags = false, bool ratings = false) {
     std::vector<std::string> features = {
         "DATE", "HOME", "AWAY", "H_SCORE", "A_SCORE",
         "H_FGA", "A_FGA", "H_FG", "A_FG", "H_FG%", "A_FG%", "H_2FGA", "A_2FGA",	"H_2FG", "A_2FG", "H_2FG%", "A_2FG%", "H_3FGA", "A_3FGA", "H_3FG", "A_3FG", "H_3FG%",
@@ -768,8 +302,9 @@ int main(int argc, char* argv[]) {
         "H_TOV", "A_TOV", "H_STL", "A_STL", "H_P_FOULS", "A_P_FOULS", "H_OFF_RATING", "A_OFF_RATING", "H_DEF_RATING", "A_DEF_RATING", "H_REST_DAYS", "A_REST_DAYS",
         "H_FG%_ALLOWED", "A_FG%_ALLOWED", "H_2FG%_ALLOWED", "A_2FG%_ALLOWED", "H_3FG%_ALLOWED", "A_3FG%_ALLOWED", "H_TOV_ALLOWED", "A_TOV_ALLOWED",
         "H_STDDEV", "A_STDDEV", 
-        //"H_ENTROPY", "A_ENTROPY",
-        //"H_COND_ENTROPY", "A_COND_ENTROPY",
+        "H_ENTROPY", "A_ENTROPY",
+        "H_COND_ENTROPY", "A_COND_ENTROPY",
+        "H2H_MEETINGS", "H2H_TOTAL", "H2H_MARGIN", "H2H_PACE",
         //"H_SKEW", "A_SKEW", "H_KURTOSIS", "A_KURTOSIS",
         "H_2FG_RATE", "A_2FG_RATE", "H_3FG_RATE", "A_3FG_RATE", "H_FT_RATE", "A_FT_RATE",
         "H_TOV_RATE", "A_TOV_RATE", "H_OREB_RATE", "A_OREB_RATE", "H_DREB_RATE", "A_DREB_RATE",
@@ -786,12 +321,330 @@ int main(int argc, char* argv[]) {
         "HIGH_SCORING_SETUP", "LOW_SCORING_SETUP",
         "TOTAL_OFF_STRENGTH", "TOTAL_DEF_STRENGTH", "PACE_SQUARED", "AVG_3FG_RATE", "EFFICIENCY_GAP",
         "EXPECTED_STDDEV",
+        "H_TOTAL_EWM", "A_TOTAL_EWM", "H_TOTAL_STD", "A_TOTAL_STD",
         "TOTAL",
     };
+    if (ratings) {
+        features.insert(features.end() - 1, rating_columns().begin(), rating_columns().end());
+    }
+    if (robust_lags) {
+        std::vector<std::string> robust = robust_lag_columns<nba_schema>();
+        features.insert(features.end() - 1, robust.begin(), robust.end());
+    }
+    return features;
+}
+
+// Per-team, per-season home/away splits written next to the feature file.
+void write_team_splits(dataframe& basketball_data, const std::string& output) {
+    FE_PROFILE_SCOPE("team_splits");
+    for (const std::string side : { "HOME", "AWAY" }) {
+        const std::string p = (side == "HOME") ? "H_" : "A_";
+        dataframe splits = group_by(basketball_data, { "SEASON", side }, {
+            { "TOTAL", aggregate::count, "GAMES" },
+            { "GAME_PACE", aggregate::mean, "PACE" },
+            { p + "SCORE", aggregate::mean, "SCORE" },
+            { p + "OFF_RATING", aggregate::mean, "OFF_RATING" },
+            { p + "DEF_RATING", aggregate::mean, "DEF_RATING" },
+            { "TOTAL", aggregate::mean, "TOTAL_MEAN" },
+            { "TOTAL", aggregate::stddev, "TOTAL_STDDEV" },
+            { "TOTAL", aggregate::min, "TOTAL_MIN" },
+            { "TOTAL", aggregate::max, "TOTAL_MAX" },
+        });
+        std::string splits_file = get_modified_filePath(output, side == "HOME" ? "_home_splits" : "_away_splits");
+        save_to_csv(splits, splits_file, { "SEASON", side, "GAMES", "PACE", "SCORE", "OFF_RATING", "DEF_RATING",
+            "TOTAL_MEAN", "TOTAL_STDDEV", "TOTAL_MIN", "TOTAL_MAX" });
+    }
+}
 
-    std::string data_file = std::string{ fs::path(files[0]).parent_path().string() + R"(\data_file.csv)" };
-    save_to_csv(basketball_data, data_file, features);
-    if (!fs::remove(fs::path(combinedFile)) || !fs::remove(fs::path(modified_filename_1)) || !fs::remove(fs::path(modified_filename_3))) {
-        std::cerr << "Error deleting temporary files\n";
+// Builds the view for one manifest subset: terms joined by '&', each either a flag column
+// ("FAST_PACE") or an exact match ("SEASON=2024-2025").
+dataframe_view subset_view(dataframe& basketball_data, const std::string& subset) {
+    dataframe_view view(basketball_data);
+    std::stringstream ss(subset);
+    std::string term;
+    while (std::getline(ss, term, '&')) {
+        size_t first = term.find_first_not_of(' ');
+        size_t last = term.find_last_not_of(' ');
+        if (first == std::string::npos) throw std::runtime_error("Empty term in subset '" + subset + "'");
+        term = term.substr(first, last - first + 1);
+        size_t eq = term.find('=');
+        if (eq == std::string::npos) {
+            view = view.where(term);
+        }
+        else {
+            std::string column = term.substr(0, eq);
+            column.erase(column.find_last_not_of(' ') + 1);
+            std::string value = term.substr(eq + 1);
+            value.erase(0, value.find_first_not_of(' '));
+            auto it = basketball_data.find(column);
+            if (it == basketball_data.end()) throw std::runtime_error("No column named '" + column + "' in subset '" + subset + "'");
+            view = view.where(select_equal(it->second, value));
+        }
+    }
+    return view;
+}
+
+// Each subset is written as "<output>_<name>.csv", where the name is the subset spec with
+// anything that isn't a letter, digit or '-' turned into '_'.
+void write_subsets(dataframe& basketball_data, const std::string& output, const std::vector<std::string>& subsets, const std::vector<std::string>& features) {
+    FE_PROFILE_SCOPE("subsets");
+    for (const auto& subset : subsets) {
+        dataframe_view view = subset_view(basketball_data, subset);
+        std::string name;
+        for (char c : subset) {
+            if (c == ' ') continue;
+            name += (std::isalnum(static_cast<unsigned char>(c)) || c == '-') ? c : '_';
+        }
+        save_to_csv(view, get_modified_filePath(output, "_" + name), features);
     }
-}
\ No newline at end of file
+}
+
+// Season stages: add the year to every date, put backfilled rows back in newest-first order,
+// then reverse into chronological order with rest days.
+// Returns the "_reversed_plus_rest_days" file that the combine stage reads.
+std::string prepare_season(const std::string& filename, rating_engine* ratings = nullptr) {
+    std::string modified_filename_1 = get_modified_filePath(filename, "_modified_date");
+    modify_dates(filename, modified_filename_1);
+    sort_by_date(modified_filename_1, date_order::descending);
+    std::string modified_filename_2 = get_modified_filePath(filename, "_reversed_plus_rest_days");
+    calculate_and_insert_rest_days(modified_filename_1, modified_filename_2, ratings);
+    fs::remove(fs::path(modified_filename_1));
+    return modified_filename_2;
+}
+
+void build_feature_file(const std::string& combined_file, int window_size, const std::string& output, const league_job& job) {
+    std::string lagged_file = get_modified_filePath(combined_file, "_lagged_averages_w" + std::to_string(window_size));
+    lag_options lags = job.lags;
+    lags.window_size = window_size;
+    calculate_and_create_lagged_averages(combined_file, lagged_file, lags);
+
+    dataframe basketball_data = load_data(lagged_file, { "DATE", "HOME", "AWAY" });
+    add_derived_features(basketball_data);
+    basketball_data["SEASON"] = season_column(basketball_data["DATE"]);
+    const std::vector<std::string> features = output_features(lags.robust, job.ratings.enabled);
+    if (job.export_csv) {
+        save_to_csv(basketball_data, output, features);
+    }
+    for (npy_dtype dtype : job.npy_exports) {
+        std::string suffix = (dtype == npy_dtype::float64 && job.npy_exports.size() > 1) ? "_f64" : "";
+        std::string matrix_file = fs::path(get_modified_filePath(output, suffix)).replace_extension(".npy").string();
+        save_to_npy(basketball_data, matrix_file, features, dtype, job.npy_layout);
+    }
+    if (!job.correlation_target.empty()) {
+        correlation_report report = correlation_analysis(basketball_data, features, job.correlation_target);
+        save_correlation_report(report, fs::path(output).replace_extension("").string());
+    }
+    if (job.describe) {
+        describe_report report = describe(basketball_data, features, "SEASON");
+        save_describe_report(report, fs::path(output).replace_extension("").string());
+    }
+    write_subsets(basketball_data, output, job.subsets, features);
+    write_team_splits(basketball_data, output);
+    fs::remove(fs::path(lagged_file));
+}
+
+// State of one league's run. Every job combines into its own file, so jobs never share
+// anything but the worker pool.
+struct job_state {
+    league_job job;
+    std::vector<std::string> prepared;
+    std::string combined_file;
+    std::unique_ptr<rating_engine> ratings; // set when the job has ratings on
+    std::atomic<size_t> pending_seasons{ 0 };
+    std::atomic<size_t> pending_windows{ 0 };
+    std::atomic<bool> failed{ false };
+    std::mutex error_mutex;
+    std::string error;
+
+    void fail(const std::string& stage, const std::exception& e) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (error.empty()) error = stage + ": " + e.what();
+        failed = true;
+    }
+};
+
+// Runs every job on one shared pool. Seasons of all leagues are prepared in parallel;
+// the last season to finish queues its league's combine step, which in turn queues one
+// lagged-averages + features task per window size. Ratings carry from one season into the
+// next, so a league with ratings on prepares its seasons in order on a single task.
+// The window tasks of all leagues can run side by side, so the operators inside a task
+// split the cores between them rather than each using all of them.
+bool run_jobs(const std::vector<league_job>& jobs) {
+    size_t window_tasks = 0;
+    for (const auto& job : jobs) {
+        window_tasks += job.windows.size();
+    }
+    thread_pool pool(worker_count(), std::max<size_t>(1, worker_count() / std::max<size_t>(1, window_tasks)));
+    std::vector<std::unique_ptr<job_state>> states;
+    for (const auto& job : jobs) {
+        auto state = std::make_unique<job_state>();
+        state->job = job;
+        state->prepared.resize(job.seasons.size());
+        state->pending_seasons = job.seasons.size();
+        state->combined_file = (fs::path(job.output).parent_path() / (job.league + "_combined.csv")).string();
+        if (job.ratings.enabled) state->ratings = std::make_unique<rating_engine>(job.ratings);
+        states.push_back(std::move(state));
+    }
+
+    for (auto& owned : states) {
+        job_state* state = owned.get();
+        auto build = [state](size_t w) {
+            int window_size = state->job.windows[w];
+            std::string output = (w == 0) ? state->job.output
+                : get_modified_filePath(state->job.output, "_w" + std::to_string(window_size));
+            try {
+                build_feature_file(state->combined_file, window_size, output, state->job);
+            }
+            catch (const std::exception& e) {
+                state->fail("window " + std::to_string(window_size), e);
+            }
+            if (--state->pending_windows == 0) {
+                fs::remove(fs::path(state->combined_file));
+            }
+        };
+        auto combine = [&pool, state, build]() {
+            if (state->failed) return;
+            try {
+                combine_files(state->prepared, state->combined_file);
+                sort_by_date(state->combined_file, date_order::ascending);
+            }
+            catch (const std::exception& e) {
+                state->fail("combine", e);
+                return;
+            }
+            state->pending_windows = state->job.windows.size();
+            for (size_t w = 0; w < state->job.windows.size(); ++w) {
+                pool.submit([build, w]() { build(w); });
+            }
+        };
+        auto prepare = [state](size_t i) {
+            try {
+                state->prepared[i] = prepare_season(state->job.seasons[i], state->ratings.get());
+            }
+            catch (const std::exception& e) {
+                state->fail(state->job.seasons[i], e);
+            }
+        };
+        if (state->ratings) {
+            pool.submit([&pool, state, combine, prepare]() {
+                for (size_t i = 0; i < state->job.seasons.size() && !state->failed; ++i) {
+                    prepare(i);
+                }
+                if (!state->failed && state->ratings->sweeping()) {
+                    try {
+                        save_rating_sweep(state->ratings->sweep_results(), get_modified_filePath(state->job.output, "_rating_sweep"));
+                    }
+                    catch (const std::exception& e) {
+                        state->fail("rating sweep", e);
+                    }
+                }
+                pool.submit(combine);
+            });
+            continue;
+        }
+        for (size_t i = 0; i < state->job.seasons.size(); ++i) {
+            pool.submit([&pool, state, combine, prepare, i]() {
+                prepare(i);
+                if (--state->pending_seasons == 0) {
+                    pool.submit(combine);
+                }
+            });
+        }
+    }
+    pool.wait_idle();
+
+    bool ok = true;
+    for (const auto& state : states) {
+        if (state->failed) {
+            std::cerr << "ERROR: [" << state->job.league << "] " << state->error << "\n";
+            ok = false;
+        }
+        else {
+            std::cout << "[" << state->job.league << "] done: " << state->job.output << "\n";
+        }
+    }
+    return ok;
+}
+
+// Daemon mode: prepares the league's seasons, loads them into a feature store with the
+// league's first window size and answers feature requests on `socket_path`. Seasons are
+// prepared from copies in a scratch directory that is removed once they are loaded, so the
+// batch job's intermediates next to the season files are never touched. With ratings on,
+// the seasons go through the same rating pass as the batch.
+void serve_league(const std::vector<league_job>& jobs, const std::string& league, const std::string& socket_path) {
+    auto job = std::find_if(jobs.begin(), jobs.end(), [&league](const league_job& j) { return j.league == league; });
+    if (job == jobs.end()) {
+        throw std::runtime_error("No league [" + league + "] in the manifest");
+    }
+    feature_store store(derived_feature_block(), output_features(job->lags.robust, job->ratings.enabled), job->windows[0],
+        TOTAL_EWM_ALPHA, TOTAL_STD_WINDOW, job->lags.robust, job->ratings);
+    std::unique_ptr<rating_engine> ratings;
+    if (job->ratings.enabled) {
+        rating_options emitted_only = job->ratings;
+        emitted_only.sweep_k.clear();
+        emitted_only.sweep_home_advantage.clear();
+        ratings = std::make_unique<rating_engine>(emitted_only);
+    }
+
+    const fs::path scratch = fs::temp_directory_path() / ("fe_serve_" + league + "_" + std::to_string(std::hash<std::string>{}(socket_path)));
+    try {
+        for (size_t i = 0; i < job->seasons.size(); ++i) {
+            // One directory per season keeps the "yyyy-yyyy.csv" name modify_dates reads the year from.
+            const fs::path directory = scratch / std::to_string(i);
+            fs::create_directories(directory);
+            const fs::path copy = directory / fs::path(job->seasons[i]).filename();
+            fs::copy_file(job->seasons[i], copy, fs::copy_options::overwrite_existing);
+            store.load(prepare_season(copy.string(), ratings.get()));
+        }
+    }
+    catch (...) {
+        std::error_code ignored;
+        fs::remove_all(scratch, ignored);
+        throw;
+    }
+    fs::remove_all(scratch);
+    serve_features(store, socket_path);
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		menu();
+		exit(1);
+	}
+	std::string filename = std::string(argv[1]);
+    bool profile = false;
+    std::string serve_league_name, socket_path;
+    for (int i = 2; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--profile") {
+            profile = true;
+        }
+        else if (option == "--serve" && i + 2 < argc) {
+            serve_league_name = argv[++i];
+            socket_path = argv[++i];
+        }
+        else {
+            menu();
+            exit(1);
+        }
+    }
+
+    try {
+        bool ok = true;
+        if (!serve_league_name.empty()) {
+            serve_league(load_manifest(filename), serve_league_name, socket_path);
+        }
+        else if (fs::path(filename).extension() == ".csv") {
+            prepare_season(filename);
+        }
+        else {
+            ok = run_jobs(load_manifest(filename));
+        }
+        if (profile) profile_report(std::cout);
+        return ok ? 0 : 1;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+// Bounded lock-free ring for exactly one producer thread and one consumer thread.
+// Head and tail live on separate cache lines, and each side keeps a cached copy of the
+// other's index so the shared counters are only re-read when the ring looks full/empty.
+template <typename T>
+class spsc_queue {
+public:
+	explicit spsc_queue(size_t capacity) {
+		size_t size = 1;
+		while (size < capacity) size <<= 1;
+		slots.resize(size);
+		mask = size - 1;
+	}
+
+	spsc_queue(const spsc_queue&) = delete;
+	spsc_queue& operator=(const spsc_queue&) = delete;
+
+	// Producer side. Leaves `value` untouched when the ring is full.
+	bool try_push(T& value) {
+		const size_t t = tail.load(std::memory_order_relaxed);
+		if (t - cached_head == slots.size()) {
+			cached_head = head.load(std::memory_order_acquire);
+			if (t - cached_head == slots.size()) return false;
+		}
+		slots[t & mask] = std::move(value);
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side.
+	bool try_pop(T& value) {
+		const size_t h = head.load(std::memory_order_relaxed);
+		if (h == cached_tail) {
+			cached_tail = tail.load(std::memory_order_acquire);
+			if (h == cached_tail) return false;
+		}
+		value = std::move(slots[h & mask]);
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	void push(T value) {
+		while (!try_push(value)) std::this_thread::yield();
+	}
+
+	void pop(T& value) {
+		while (!try_pop(value)) std::this_thread::yield();
+	}
+
+private:
+	std::vector<T> slots;
+	size_t mask = 0;
+	alignas(64) std::atomic<size_t> head{ 0 }; // next slot to pop, written by the consumer
+	alignas(64) std::atomic<size_t> tail{ 0 }; // next slot to push, written by the producer
+	alignas(64) size_t cached_head = 0;        // producer's last view of head
+	alignas(64) size_t cached_tail = 0;        // consumer's last view of tail
+};
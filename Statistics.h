@@ -0,0 +1,303 @@
+#pragma once
+#include <array>
+#include <deque>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <iterator>
+#include <cmath>
+
+// Range versions let callers average part of a history without copying it.
+template <typename It>
+double mean(It first, It last) {
+    if (first == last) return 0;
+    int size = std::distance(first, last);
+    double result = std::accumulate(first, last, 0.0) / double(size);
+    return result;
+}
+
+double mean(const std::deque<double>& scores) {
+    return mean(std::begin(scores), std::end(scores));
+}
+
+double standard_deviation(const std::deque<double>& scores, double mean) {
+    if (scores.size() < 2) {
+        return 0;
+    }
+    float sum_squared_diff{ 0.0 };
+    int size = scores.size();
+    for (const auto& elem : scores) {
+        sum_squared_diff += (elem - mean) * (elem - mean);
+    }
+    sum_squared_diff /= float(size - 1);
+    float stddev = std::sqrt(sum_squared_diff);
+    return stddev;
+}
+
+double skew(const std::deque<double>& scores) {
+    double avg = mean(scores);
+    size_t N = scores.size();
+    double result = 0.0;
+    for (size_t i{ 0 }; i < N; ++i) {
+        result += (scores[i] - avg) * (scores[i] - avg) * (scores[i] - avg);
+    }
+    result /= (double)N;
+    double var = std::pow(standard_deviation(scores, avg), 2);
+    var = std::pow(var, 1.5);
+    if (var < 1e-9) return 0.0;
+    result /= var;
+    return result;
+}
+
+double kurtosis(const std::deque<double>& scores) {
+    double avg = mean(scores);
+    size_t N = scores.size();
+
+    if (N < 4) return 0.0;
+
+    double result = 0.0;
+
+    for (size_t i = 0; i < N; ++i) {
+        double diff = scores[i] - avg;
+        result += diff * diff * diff * diff;
+    }
+    result /= (double)N;
+
+    double var = std::pow(standard_deviation(scores, avg), 2);
+    if (var < 1e-9) return 0.0;
+
+    result /= (var * var); // divide by σ^4
+    result -= 3.0;         // excess kurtosis (normal → 0)
+
+    return result;
+}
+
+
+template <typename It>
+double exponential_smoothing(It first, It last, double alpha) {
+    int N = std::distance(first, last);
+    if (N == 0) return 0;
+    if (N < 2) return *first;
+
+    int k = N/2;
+    double smoothed = mean(first, first + k);
+    
+    for (It it = std::next(first); it != last; ++it) {
+        smoothed = alpha * *it + (1 - alpha) * smoothed;
+    }
+    return smoothed;
+}
+
+auto exponential_smoothing(const std::deque<double>& vec, double alpha) -> double {
+    return exponential_smoothing(vec.begin(), vec.end(), alpha);
+}
+
+template <typename It>
+float predict_next_score(It first, It last) {
+    return 0.5 * mean(first, last) + 0.5 * exponential_smoothing(first, last, 0.25);
+}
+
+float predict_next_score(const std::deque<double>& scores) {
+    return predict_next_score(scores.begin(), scores.end());
+}
+
+double entropy(const std::vector<double>& probabilities) {
+    double result = 0.0;
+    for (auto pi : probabilities) {
+        if (pi > 0)
+            result += pi * std::log2(pi);
+    }
+    result *= -1;
+    return result;
+}
+
+// c * log2(c) for every count a lag window can reach, so an entropy costs no logarithm per
+// symbol; larger counts fall back to std::log2.
+constexpr int COUNT_LOG2_TABLE_SIZE = 256;
+
+double count_log2(int count) {
+    static const std::array<double, COUNT_LOG2_TABLE_SIZE> table = []() {
+        std::array<double, COUNT_LOG2_TABLE_SIZE> t{};
+        for (int c = 1; c < COUNT_LOG2_TABLE_SIZE; ++c) {
+            t[c] = c * std::log2(double(c));
+        }
+        return t;
+    }();
+    return count < COUNT_LOG2_TABLE_SIZE ? table[count] : count * std::log2(double(count));
+}
+
+// Counts over a fixed alphabet of `Symbols`, kept on the stack. With N symbols seen,
+// H = log2(N) - sum(c * log2(c)) / N, and add keeps that sum current, so reading the entropy
+// costs no pass over the counts.
+template <int Symbols>
+class symbol_histogram {
+public:
+    void add(int symbol) {
+        weighted -= count_log2(counts[symbol]);
+        weighted += count_log2(++counts[symbol]);
+        ++total;
+    }
+
+    int count(int symbol) const {
+        return counts[symbol];
+    }
+
+    int size() const {
+        return total;
+    }
+
+    // sum(c * log2(c)) over the symbols.
+    double weighted_counts() const {
+        return weighted;
+    }
+
+    double entropy() const {
+        if (total == 0) return 0.0;
+        return (count_log2(total) - weighted) / total;
+    }
+
+private:
+    int counts[Symbols] = {};
+    int total = 0;
+    double weighted = 0.0;
+};
+
+// range_bin symbols: below one standard deviation under the mean, within it, above it.
+constexpr int RANGE_SYMBOLS = 3;
+
+int range_bin(double value, double avg, double stddev) {
+    if (value < avg - stddev) return 0;
+    if (value > avg + stddev) return 2;
+    return 1;
+}
+
+// Transitions between consecutive symbols. H(next | previous) = H(previous, next) - H(previous)
+// over the T transitions, which reduces to (sum(c * log2(c)) of the previous symbols - the
+// same sum over the pairs) / T.
+template <int Symbols>
+class transition_histogram {
+public:
+    void add(int previous, int next) {
+        pairs.add(previous * Symbols + next);
+        previous_symbols.add(previous);
+    }
+
+    double conditional_entropy() const {
+        if (pairs.size() == 0) return 0.0;
+        return (previous_symbols.weighted_counts() - pairs.weighted_counts()) / pairs.size();
+    }
+
+private:
+    symbol_histogram<Symbols * Symbols> pairs;
+    symbol_histogram<Symbols> previous_symbols;
+};
+
+struct range_entropies {
+    double entropy = 0.0;
+    double conditional_entropy = 0.0;
+};
+
+// Entropy of the range_bin symbols of one or more series, and the conditional entropy of
+// each symbol given the one before it in the same series; each series is its own time line,
+// so no transition is counted from the end of one to the start of the next. The bins are the
+// caller's mean +- one standard deviation, which move whenever a lag window does, so the
+// histograms are rebuilt for every row rather than slid.
+class range_entropy_counter {
+public:
+    range_entropy_counter(double avg, double stddev) : avg(avg), stddev(stddev) {}
+
+    template <typename It>
+    void add_series(It first, It last) {
+        int previous = -1;
+        for (; first != last; ++first) {
+            int symbol = range_bin(*first, avg, stddev);
+            symbols.add(symbol);
+            if (previous >= 0) transitions.add(previous, symbol);
+            previous = symbol;
+        }
+    }
+
+    range_entropies result() const {
+        return { symbols.entropy(), transitions.conditional_entropy() };
+    }
+
+private:
+    double avg, stddev;
+    symbol_histogram<RANGE_SYMBOLS> symbols;
+    transition_histogram<RANGE_SYMBOLS> transitions;
+};
+
+// Values of a sliding window kept in sorted order, so any order statistic is one index.
+// insert and erase are a binary search plus a shift of at most the window's size; for lag
+// windows (a few dozen values) that beats the pointer chasing of a heap pair or skiplist,
+// and unlike two heaps it answers every quantile, not just the median.
+class order_statistic_window {
+public:
+    // NaN and +-inf are not kept: a NaN has no place in the order and could never be erased
+    // again, so the window only ever holds the finite values it was given.
+    void insert(double value) {
+        if (!std::isfinite(value)) return;
+        sorted.insert(std::upper_bound(sorted.begin(), sorted.end(), value), value);
+    }
+
+    // Removes one copy of `value`, if present.
+    void erase(double value) {
+        if (!std::isfinite(value)) return;
+        auto it = std::lower_bound(sorted.begin(), sorted.end(), value);
+        if (it != sorted.end() && *it == value) sorted.erase(it);
+    }
+
+    size_t size() const {
+        return sorted.size();
+    }
+
+    // The rank-th smallest value, 0-based.
+    double operator[](size_t rank) const {
+        return sorted[rank];
+    }
+
+    // Rank of the first copy of `value`.
+    size_t rank_of(double value) const {
+        return std::lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin();
+    }
+
+private:
+    std::vector<double> sorted;
+};
+
+constexpr double TRIM_FRACTION = 0.2;
+
+struct robust_summary {
+    double median = 0.0;
+    double iqr = 0.0;
+    double trimmed_mean = 0.0; // mean of the values left after dropping TRIM_FRACTION from each end
+};
+
+// Median, interquartile range and trimmed mean of a window, optionally leaving out one copy
+// of `*excluded` (a non-finite one was never inserted). Quantiles interpolate linearly
+// between ranks.
+robust_summary summarize(const order_statistic_window& window, const double* excluded = nullptr) {
+    if (excluded && !std::isfinite(*excluded)) excluded = nullptr;
+    const size_t skip = excluded ? window.rank_of(*excluded) : window.size();
+    const size_t n = window.size() - (excluded ? 1 : 0);
+    robust_summary summary;
+    if (n == 0) return summary;
+
+    auto at = [&](size_t rank) { return window[rank < skip ? rank : rank + 1]; };
+    auto quantile = [&](double q) {
+        double position = q * double(n - 1);
+        size_t lower = static_cast<size_t>(position);
+        double fraction = position - double(lower);
+        return lower + 1 < n ? at(lower) + fraction * (at(lower + 1) - at(lower)) : at(lower);
+    };
+    summary.median = quantile(0.5);
+    summary.iqr = quantile(0.75) - quantile(0.25);
+
+    const size_t trim = static_cast<size_t>(TRIM_FRACTION * double(n));
+    double sum = 0.0;
+    for (size_t rank = trim; rank < n - trim; ++rank) {
+        sum += at(rank);
+    }
+    summary.trimmed_mean = sum / double(n - 2 * trim);
+    return summary;
+}
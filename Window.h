@@ -0,0 +1,236 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include "DataFrame.h"
+#include "Date.h"
+#include "Parallel.h"
+
+// Window operators compute per-row values from the history of a partition (for example
+// all games of one HOME team) ordered by a sort column (for example DATE).
+struct window_spec {
+	std::string partition_by;
+	std::string order_by;
+	bool exclude_current = false; // window ends at the previous row: history-only, pre-game features
+};
+
+// Rows grouped by partition and sorted inside each partition. Partition p covers
+// rows[offsets[p]] .. rows[offsets[p + 1] - 1].
+struct partitioned_order {
+	std::vector<std::uint32_t> rows;
+	std::vector<size_t> offsets;
+};
+
+// Sort key for the order column: day number for "dd.mm.yyyy." dates, otherwise the numeric value.
+// Nulls sort last.
+double window_order_key(const std::string& cell) {
+	long long day = day_number(cell);
+	if (day >= 0) return double(day);
+	double value;
+	return parse_double(cell, value) ? value : std::numeric_limits<double>::infinity();
+}
+
+// One sort pass: partition keys are interned to integer ids (a categorical column already
+// has them), then rows are sorted by (partition id, order key, original position), so ties
+// keep file order.
+partitioned_order partition_rows(const dataframe& data, const window_spec& spec) {
+	auto partition_it = data.find(spec.partition_by);
+	auto order_it = data.find(spec.order_by);
+	if (partition_it == data.end() || order_it == data.end()) {
+		throw std::runtime_error("Window: no column named '" + (partition_it == data.end() ? spec.partition_by : spec.order_by) + "'");
+	}
+	const string_vector& partition = partition_it->second;
+	const string_vector& order = order_it->second;
+	if (partition.size() != order.size()) {
+		throw std::runtime_error("Window: partition and order columns must be the same length.");
+	}
+
+	const size_t rows = partition.size();
+	std::vector<std::uint32_t> partition_id(rows);
+	std::vector<double> key(rows);
+	if (partition.is_categorical()) {
+		partition_id = partition.codes();
+	}
+	else {
+		std::unordered_map<std::string, std::uint32_t> ids;
+		for (size_t i = 0; i < rows; ++i) {
+			partition_id[i] = ids.try_emplace(partition[i], static_cast<std::uint32_t>(ids.size())).first->second;
+		}
+	}
+	if (order.is_categorical()) {
+		std::vector<double> category_key(order.categories().size());
+		for (std::uint32_t c = 0; c < category_key.size(); ++c) {
+			category_key[c] = window_order_key(order.categories()[c]);
+		}
+		for (size_t i = 0; i < rows; ++i) {
+			key[i] = category_key[order.codes()[i]];
+		}
+	}
+	else {
+		for (size_t i = 0; i < rows; ++i) {
+			key[i] = window_order_key(order[i]);
+		}
+	}
+
+	partitioned_order result;
+	result.rows.resize(rows);
+	for (size_t i = 0; i < rows; ++i) {
+		result.rows[i] = static_cast<std::uint32_t>(i);
+	}
+	std::sort(result.rows.begin(), result.rows.end(), [&](std::uint32_t a, std::uint32_t b) {
+		if (partition_id[a] != partition_id[b]) return partition_id[a] < partition_id[b];
+		if (key[a] != key[b]) return key[a] < key[b];
+		return a < b;
+	});
+
+	result.offsets.push_back(0);
+	for (size_t i = 1; i < rows; ++i) {
+		if (partition_id[result.rows[i]] != partition_id[result.rows[i - 1]]) {
+			result.offsets.push_back(i);
+		}
+	}
+	result.offsets.push_back(rows);
+	if (rows == 0) result.offsets.resize(1);
+	return result;
+}
+
+// Gathers each partition into contiguous buffers, runs kernel(in, in_valid, n, out, out_valid)
+// over it, and scatters the results back into original row order. Partitions run in parallel.
+template <typename Kernel>
+string_vector window_apply(const dataframe& data, const std::string& column, const window_spec& spec, Kernel kernel) {
+	FE_PROFILE_SCOPE("window");
+	auto it = data.find(column);
+	if (it == data.end()) {
+		throw std::runtime_error("Window: no column named '" + column + "'");
+	}
+	numeric_column input = it->second.to_numeric();
+	partitioned_order order = partition_rows(data, spec);
+	if (input.values.size() != order.rows.size()) {
+		throw std::runtime_error("Window: column '" + column + "' has a different length than the partition column.");
+	}
+
+	const size_t rows = order.rows.size();
+	const size_t partitions = order.offsets.size() - 1;
+	std::vector<double> values(rows, std::numeric_limits<double>::quiet_NaN());
+	std::vector<std::uint8_t> valid(rows, 0);
+
+	parallel_chunks(partitions, [&](size_t, size_t begin, size_t end) {
+		std::vector<double> in, out;
+		std::vector<std::uint8_t> in_valid, out_valid;
+		for (size_t p = begin; p < end; ++p) {
+			const size_t first = order.offsets[p];
+			const size_t n = order.offsets[p + 1] - first;
+			in.resize(n);
+			in_valid.resize(n);
+			out.assign(n, std::numeric_limits<double>::quiet_NaN());
+			out_valid.assign(n, 0);
+			for (size_t k = 0; k < n; ++k) {
+				std::uint32_t row = order.rows[first + k];
+				in[k] = input.values[row];
+				in_valid[k] = input.validity.test(row);
+			}
+			kernel(in.data(), in_valid.data(), n, out.data(), out_valid.data());
+			for (size_t k = 0; k < n; ++k) {
+				std::uint32_t row = order.rows[first + k];
+				values[row] = out[k];
+				valid[row] = out_valid[k];
+			}
+		}
+	});
+
+	validity_bitmap mask(rows);
+	for (size_t i = 0; i < rows; ++i) {
+		mask.set(i, valid[i] != 0);
+	}
+	return string_vector::from_numeric(values, mask);
+}
+
+// Value from `offset` rows earlier in the partition (null for the first `offset` rows).
+string_vector lag(const dataframe& data, const std::string& column, const window_spec& spec, size_t offset = 1) {
+	return window_apply(data, column, spec, [offset](const double* in, const std::uint8_t* in_valid, size_t n, double* out, std::uint8_t* out_valid) {
+		for (size_t k = offset; k < n; ++k) {
+			out[k] = in[k - offset];
+			out_valid[k] = in_valid[k - offset];
+		}
+	});
+}
+
+// Change since `offset` rows earlier; with exclude_current the difference is taken one row back.
+string_vector diff(const dataframe& data, const std::string& column, const window_spec& spec, size_t offset = 1) {
+	const size_t shift = spec.exclude_current ? 1 : 0;
+	return window_apply(data, column, spec, [offset, shift](const double* in, const std::uint8_t* in_valid, size_t n, double* out, std::uint8_t* out_valid) {
+		for (size_t k = offset + shift; k < n; ++k) {
+			size_t cur = k - shift;
+			out[k] = in[cur] - in[cur - offset];
+			out_valid[k] = in_valid[cur] & in_valid[cur - offset];
+		}
+	});
+}
+
+// Sliding sum and sum of squares over the last `window` rows of the partition. Nulls inside the
+// window are skipped; a row is null until the partition has `window` rows of history.
+template <typename Finish>
+string_vector rolling(const dataframe& data, const std::string& column, const window_spec& spec, size_t window, Finish finish) {
+	if (window == 0) {
+		throw std::runtime_error("Window: rolling window size must be positive.");
+	}
+	const size_t shift = spec.exclude_current ? 1 : 0;
+	return window_apply(data, column, spec, [window, shift, finish](const double* in, const std::uint8_t* in_valid, size_t n, double* out, std::uint8_t* out_valid) {
+		double sum = 0.0, sum_sq = 0.0;
+		size_t count = 0;
+		for (size_t k = 0; k + shift < n; ++k) {
+			if (in_valid[k]) {
+				sum += in[k];
+				sum_sq += in[k] * in[k];
+				++count;
+			}
+			if (k >= window && in_valid[k - window]) {
+				sum -= in[k - window];
+				sum_sq -= in[k - window] * in[k - window];
+				--count;
+			}
+			if (k + 1 >= window) {
+				out_valid[k + shift] = finish(sum, sum_sq, count, out[k + shift]);
+			}
+		}
+	});
+}
+
+string_vector rolling_mean(const dataframe& data, const std::string& column, const window_spec& spec, size_t window) {
+	return rolling(data, column, spec, window, [](double sum, double, size_t count, double& out) {
+		if (count == 0) return std::uint8_t{ 0 };
+		out = sum / double(count);
+		return std::uint8_t{ 1 };
+	});
+}
+
+// Sample standard deviation (n - 1), matching standard_deviation() in the lagged stage.
+string_vector rolling_std(const dataframe& data, const std::string& column, const window_spec& spec, size_t window) {
+	return rolling(data, column, spec, window, [](double sum, double sum_sq, size_t count, double& out) {
+		if (count < 2) return std::uint8_t{ 0 };
+		double var = (sum_sq - sum * sum / double(count)) / double(count - 1);
+		out = std::sqrt(std::max(0.0, var));
+		return std::uint8_t{ 1 };
+	});
+}
+
+// Exponentially weighted mean, s = alpha * x + (1 - alpha) * s, seeded with the first value.
+// Nulls leave the running value unchanged.
+string_vector ewm(const dataframe& data, const std::string& column, const window_spec& spec, double alpha) {
+	if (alpha <= 0.0 || alpha > 1.0) {
+		throw std::runtime_error("Window: ewm alpha must be in (0, 1].");
+	}
+	const size_t shift = spec.exclude_current ? 1 : 0;
+	return window_apply(data, column, spec, [alpha, shift](const double* in, const std::uint8_t* in_valid, size_t n, double* out, std::uint8_t* out_valid) {
+		double smoothed = 0.0;
+		bool seeded = false;
+		for (size_t k = 0; k + shift < n; ++k) {
+			if (in_valid[k]) {
+				smoothed = seeded ? alpha * in[k] + (1 - alpha) * smoothed : in[k];
+				seeded = true;
+			}
+			out[k + shift] = smoothed;
+			out_valid[k + shift] = seeded;
+		}
+	});
+}